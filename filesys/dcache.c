@@ -0,0 +1,166 @@
+/* dcache.c: Cache of directory entries.
+ *
+ * Maps a directory's inode sector and a name in it to the inode sector
+ * of the file, or records that no such file exists. Directory
+ * operations keep it coherent by invalidating the names they add or
+ * remove. The least recently used entry makes room for a new one. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Most entries kept at once. */
+#define DCACHE_SIZE 256
+
+struct dentry {
+	struct hash_elem elem;              /* Element in dentries. */
+	struct list_elem lru_elem;          /* Element in lru, newest last. */
+	disk_sector_t parent;               /* Inode sector of the directory. */
+	disk_sector_t sector;               /* Inode sector, or DCACHE_NOENT. */
+	char name[NAME_MAX + 1];
+};
+
+static struct hash dentries;
+static struct list lru;
+static size_t dentry_cnt;
+static struct lock dcache_lock;
+
+/* Statistics. */
+static long long hit_cnt;           /* Lookups answered with an inode. */
+static long long neg_hit_cnt;       /* Lookups answered with no file. */
+static long long miss_cnt;          /* Lookups left to the directory. */
+
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, elem);
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the cache. */
+void
+dcache_init (void) {
+	if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+		PANIC ("cannot allocate the directory entry cache");
+	list_init (&lru);
+	lock_init (&dcache_lock);
+}
+
+/* Returns the entry for NAME in PARENT, or a null pointer.
+ * dcache_lock must be held. */
+static struct dentry *
+dentry_find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.elem);
+	return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Removes D from the cache and frees it. dcache_lock must be held. */
+static void
+dentry_free (struct dentry *d) {
+	hash_delete (&dentries, &d->elem);
+	list_remove (&d->lru_elem);
+	dentry_cnt--;
+	free (d);
+}
+
+/* Looks NAME up in the directory whose inode is at PARENT. Returns
+ * false if the cache does not know. Otherwise sets *SECTORP to the
+ * file's inode sector, or to DCACHE_NOENT if there is no such file,
+ * and returns true. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_back (&lru, &d->lru_elem);
+		*sectorp = d->sector;
+		if (d->sector != DCACHE_NOENT)
+			hit_cnt++;
+		else
+			neg_hit_cnt++;
+	} else
+		miss_cnt++;
+	lock_release (&dcache_lock);
+	return d != NULL;
+}
+
+/* Records that NAME in PARENT has its inode at SECTOR, or does not
+ * exist if SECTOR is DCACHE_NOENT. */
+void
+dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d == NULL) {
+		if (dentry_cnt >= DCACHE_SIZE)
+			dentry_free (list_entry (list_front (&lru), struct dentry,
+						lru_elem));
+		d = malloc (sizeof *d);
+		if (d == NULL) {
+			lock_release (&dcache_lock);
+			return;
+		}
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dentries, &d->elem);
+		dentry_cnt++;
+	} else
+		list_remove (&d->lru_elem);
+	d->sector = sector;
+	list_push_back (&lru, &d->lru_elem);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets what is known about NAME in PARENT. */
+void
+dcache_invalidate (disk_sector_t parent, const char *name) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d != NULL)
+		dentry_free (d);
+	lock_release (&dcache_lock);
+}
+
+/* Prints cache statistics. */
+void
+dcache_print_stats (void) {
+	printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses\n",
+			hit_cnt, neg_hit_cnt, miss_cnt);
+}
@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 #include "filesys/fat.h"
 
@@ -21,6 +24,33 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* In-memory index of a directory's entries, built on the first lookup
+ * and kept with the directory's inode until it is closed. */
+struct dir_index {
+	struct hash names;                  /* struct dir_slot, by name. */
+	off_t *free_ofs;                    /* Offsets of free entries. */
+	size_t free_cnt;
+	size_t free_cap;
+};
+
+/* An entry in use, as found in a directory index. */
+struct dir_slot {
+	struct hash_elem elem;              /* Element in dir_index names. */
+	disk_sector_t inode_sector;
+	off_t ofs;                          /* Byte offset of the entry. */
+	char name[NAME_MAX + 1];
+};
+
+/* Serializes lookups and changes in directories, which share their
+ * name indexes and the dentry cache. */
+static struct lock dir_lock;
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	lock_init (&dir_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -77,6 +107,116 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+static uint64_t
+dir_slot_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_string (hash_entry (e, struct dir_slot, elem)->name);
+}
+
+static bool
+dir_slot_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dir_slot *a = hash_entry (a_, struct dir_slot, elem);
+	const struct dir_slot *b = hash_entry (b_, struct dir_slot, elem);
+	return strcmp (a->name, b->name) < 0;
+}
+
+static void
+dir_slot_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct dir_slot, elem));
+}
+
+/* Frees INDEX. Called when the inode of its directory is freed. */
+void
+dir_index_destroy (struct dir_index *index) {
+	if (index != NULL) {
+		hash_destroy (&index->names, dir_slot_free);
+		free (index->free_ofs);
+		free (index);
+	}
+}
+
+/* Records that the entry at OFS of INDEX is free. */
+static bool
+dir_index_add_free (struct dir_index *index, off_t ofs) {
+	if (index->free_cnt == index->free_cap) {
+		size_t cap = index->free_cap ? index->free_cap * 2 : 16;
+		off_t *free_ofs = realloc (index->free_ofs, cap * sizeof *free_ofs);
+		if (free_ofs == NULL)
+			return false;
+		index->free_ofs = free_ofs;
+		index->free_cap = cap;
+	}
+	index->free_ofs[index->free_cnt++] = ofs;
+	return true;
+}
+
+/* Records that the entry at OFS of INDEX holds NAME. */
+static bool
+dir_index_add_name (struct dir_index *index, const char *name,
+		disk_sector_t inode_sector, off_t ofs) {
+	struct dir_slot *slot = malloc (sizeof *slot);
+	if (slot == NULL)
+		return false;
+	slot->inode_sector = inode_sector;
+	slot->ofs = ofs;
+	strlcpy (slot->name, name, sizeof slot->name);
+	hash_insert (&index->names, &slot->elem);
+	return true;
+}
+
+/* Drops the index of DIR, after it could not be kept up to date. It
+ * is built again on the next lookup. */
+static void
+dir_index_drop (const struct dir *dir) {
+	dir_index_destroy (inode_get_dir_index (dir->inode));
+	inode_set_dir_index (dir->inode, NULL);
+}
+
+/* Returns the index of DIR, reading the whole directory once to build
+ * it if needed. Returns a null pointer if memory runs out. */
+static struct dir_index *
+dir_index_get (const struct dir *dir) {
+	struct dir_index *index = inode_get_dir_index (dir->inode);
+	struct dir_entry e;
+	off_t ofs;
+
+	if (index != NULL)
+		return index;
+
+	index = calloc (1, sizeof *index);
+	if (index == NULL)
+		return NULL;
+	if (!hash_init (&index->names, dir_slot_hash, dir_slot_less, NULL)) {
+		free (index);
+		return NULL;
+	}
+	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+			ofs += sizeof e) {
+		bool ok = e.in_use
+			? dir_index_add_name (index, e.name, e.inode_sector, ofs)
+			: dir_index_add_free (index, ofs);
+		if (!ok) {
+			dir_index_destroy (index);
+			return NULL;
+		}
+	}
+	inode_set_dir_index (dir->inode, index);
+	return index;
+}
+
+/* Returns the slot of NAME in INDEX, or a null pointer. */
+static struct dir_slot *
+dir_index_find (struct dir_index *index, const char *name) {
+	struct dir_slot key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&index->names, &key.elem);
+	return e != NULL ? hash_entry (e, struct dir_slot, elem) : NULL;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -85,12 +225,29 @@ dir_get_inode (struct dir *dir) {
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_index *index;
 	struct dir_entry e;
 	size_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	index = dir_index_get (dir);
+	if (index != NULL) {
+		struct dir_slot *slot = dir_index_find (index, name);
+		if (slot == NULL)
+			return false;
+		if (ep != NULL) {
+			ep->inode_sector = slot->inode_sector;
+			strlcpy (ep->name, slot->name, sizeof ep->name);
+			ep->in_use = true;
+		}
+		if (ofsp != NULL)
+			*ofsp = slot->ofs;
+		return true;
+	}
+
+	/* Out of memory for the index: scan the directory. */
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -110,15 +267,23 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	disk_sector_t parent, sector;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
+	parent = inode_get_inumber (dir->inode);
+	lock_acquire (&dir_lock);
+	if (!dcache_lookup (parent, name, &sector)) {
+		sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NOENT;
+		dcache_insert (parent, name, sector);
+	}
+	if (sector != DCACHE_NOENT)
+		*inode = inode_open (sector);
 	else
 		*inode = NULL;
+	lock_release (&dir_lock);
 
 	return *inode != NULL;
 }
@@ -131,6 +296,7 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_index *index;
 	struct dir_entry e;
 	off_t ofs;
 	bool success = false;
@@ -143,28 +309,44 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 		return false;
 
 	/* Check that NAME is not in use. */
+	lock_acquire (&dir_lock);
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	 * current end-of-file. */
+	index = inode_get_dir_index (dir->inode);
+	if (index != NULL)
+		ofs = index->free_cnt > 0 ? index->free_ofs[index->free_cnt - 1]
+			: inode_length (dir->inode);
+	else {
+		/* inode_read_at() will only return a short read at end of file.
+		 * Otherwise, we'd need to verify that we didn't get a short
+		 * read due to something intermittent such as low memory. */
+		for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+				ofs += sizeof e)
+			if (!e.in_use)
+				break;
+	}
 
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (success)
+		dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+	if (success && index != NULL) {
+		if (index->free_cnt > 0)
+			index->free_cnt--;
+		if (!dir_index_add_name (index, name, inode_sector, ofs))
+			dir_index_drop (dir);
+	}
 
 done:
+	lock_release (&dir_lock);
 	return success;
 }
 
@@ -173,6 +355,7 @@ done:
  * which occurs only if there is no file with the given NAME. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	struct dir_index *index;
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -182,6 +365,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	lock_acquire (&dir_lock);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
@@ -194,6 +378,16 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+	index = inode_get_dir_index (dir->inode);
+	if (index != NULL) {
+		struct dir_slot *slot = dir_index_find (index, name);
+		hash_delete (&index->names, &slot->elem);
+		free (slot);
+		if (!dir_index_add_free (index, ofs))
+			dir_index_drop (dir);
+	}
 
 	/* Remove inode. */
 	inode_remove (inode);
@@ -201,6 +395,7 @@ dir_remove (struct dir *dir, const char *name) {
 
 done:
 	inode_close (inode);
+	lock_release (&dir_lock);
 	return success;
 }
 
@@ -210,13 +405,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool found = false;
 
+	lock_acquire (&dir_lock);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	lock_release (&dir_lock);
+	return found;
 }
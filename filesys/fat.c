@@ -1,6 +1,8 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
 #include <stdio.h>
@@ -12,27 +14,54 @@
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
-	unsigned int sectors_per_cluster; /* Fixed to 1 */
+	unsigned int sectors_per_cluster; /* Chosen at format time */
 	unsigned int total_sectors; // = disk_size (filesys_disk)
 	unsigned int fat_start;
 	unsigned int fat_sectors; /* Size of FAT in sectors. */
 	unsigned int root_dir_cluster;
 };
 
+/* Sectors of the table kept in memory at once. */
+#define FAT_CACHE_SIZE 16
+
+/* Table entries in one sector. */
+#define ENTRIES_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (cluster_t))
+
+/* A sector of the table, loaded on demand. */
+struct fat_sector {
+	size_t idx;                          /* Sector number within the table. */
+	bool valid;
+	bool dirty;                          /* Changed since written back. */
+	bool accessed;                       /* Used since the clock passed. */
+	cluster_t entries[ENTRIES_PER_SECTOR];
+};
+
 /* FAT FS */
 struct fat_fs {
 	struct fat_boot bs;
-	unsigned int *fat;
+	struct fat_sector *cache;            /* FAT_CACHE_SIZE table sectors. */
+	size_t clock_hand;
+	struct lock cache_lock;              /* Protects CACHE and CLOCK_HAND. */
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
+	cluster_t last_clst;                 /* Where the next search starts. */
+	struct bitmap *used_map;             /* One bit per cluster, set if used,
+	                                        or NULL until first needed. */
+	size_t free_cnt;                     /* Clear bits in USED_MAP. */
+	long long read_cnt;                  /* Table sectors read. */
+	long long write_cnt;                 /* Table sectors written. */
 	struct lock write_lock;
 };
 
 static struct fat_fs *fat_fs;
 
+unsigned int fat_format_cluster_sectors = SECTORS_PER_CLUSTER;
+
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_cache_init (void);
+static void fat_used_map_create (void);
+static void fat_build_used_map (void);
 
 // don't have to modify 
 void
@@ -55,34 +84,11 @@ fat_init (void) {
 	fat_fs_init (); // need to write 
 }
 
-// don't have to modify 
+/* Mounts the FAT. Table sectors are read as they are needed, so
+ * this takes the same time for any disk size. */
 void
 fat_open (void) {
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
-		PANIC ("FAT load failed");
-
-	// Load FAT directly from the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
-	}
+	fat_cache_init ();
 }
 
 // don't have to modify 
@@ -96,27 +102,8 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
-	}
+	// Write the changed part of the FAT directly to the disk
+	fat_flush ();
 }
 
 // don't have to modify 
@@ -126,31 +113,43 @@ fat_create (void) {
 	fat_boot_create ();
 	fat_fs_init ();
 
-	// Create FAT table
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
-	if (fat_fs->fat == NULL)
+	// Create FAT table, all free but ROOT_DIR_CLST. The used map is
+	// known without reading the table back.
+	cluster_t *entries = calloc (1, DISK_SECTOR_SIZE);
+	if (entries == NULL)
 		PANIC ("FAT creation failed");
-
-	// Set up ROOT_DIR_CLST
-	fat_put (ROOT_DIR_CLUSTER, EOChain);
+	fat_cache_init ();
+	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+		if (i == ROOT_DIR_CLUSTER / ENTRIES_PER_SECTOR)
+			entries[ROOT_DIR_CLUSTER % ENTRIES_PER_SECTOR] = EOChain;
+		disk_write (filesys_disk, fat_fs->bs.fat_start + i, entries);
+		entries[ROOT_DIR_CLUSTER % ENTRIES_PER_SECTOR] = 0;
+	}
+	free (entries);
+	fat_used_map_create ();
+	bitmap_mark (fat_fs->used_map, ROOT_DIR_CLUSTER);
+	fat_fs->free_cnt = fat_fs->fat_length - 2;
 
 	// Fill up ROOT_DIR_CLUSTER region with 0
+	// Data sectors only ever go through the buffer cache.
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	page_cache_write (cluster_to_sector (ROOT_DIR_CLUSTER), buf, 0,
+			DISK_SECTOR_SIZE);
 	free (buf);
 }
 
 // don't have to modify 
 void
 fat_boot_create (void) {
+	unsigned int spc = fat_format_cluster_sectors;
 	unsigned int fat_sectors =
 	    (disk_size (filesys_disk) - 1)
-	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * SECTORS_PER_CLUSTER + 1) + 1;
+	    / (DISK_SECTOR_SIZE / sizeof (cluster_t) * spc + 1) + 1;
 	fat_fs->bs = (struct fat_boot){
 	    .magic = FAT_MAGIC,
-	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
+	    .sectors_per_cluster = spc,
 	    .total_sectors = disk_size (filesys_disk),
 	    .fat_start = 1,
 	    .fat_sectors = fat_sectors,
@@ -175,36 +174,208 @@ fat_fs_init (void) {
 	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
 	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
 	lock_init (&fat_fs->write_lock);
+	lock_init (&fat_fs->cache_lock);
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
+/* Empties the cache of table sectors, allocating it on first use.
+ * Dirty sectors must have been flushed. */
+static void
+fat_cache_init (void) {
+	if (fat_fs->cache == NULL) {
+		fat_fs->cache = calloc (FAT_CACHE_SIZE, sizeof *fat_fs->cache);
+		if (fat_fs->cache == NULL)
+			PANIC ("FAT cache allocation failed");
+	}
+	for (size_t i = 0; i < FAT_CACHE_SIZE; i++) {
+		ASSERT (!fat_fs->cache[i].valid || !fat_fs->cache[i].dirty);
+		fat_fs->cache[i].valid = false;
+	}
+	fat_fs->clock_hand = 0;
+}
+
+/* Writes S back if it is dirty. cache_lock must be held. */
+static void
+fat_sector_write (struct fat_sector *s) {
+	if (s->valid && s->dirty) {
+		disk_write (filesys_disk, fat_fs->bs.fat_start + s->idx, s->entries);
+		s->dirty = false;
+		fat_fs->write_cnt++;
+	}
+}
+
+/* Returns the cached table sector holding the entry of CLST, reading
+ * it in, in place of the one the clock picks, if needed.
+ * cache_lock must be held. */
+static struct fat_sector *
+fat_sector_get (cluster_t clst) {
+	size_t idx = clst / ENTRIES_PER_SECTOR;
+	struct fat_sector *s;
+
+	ASSERT (clst < fat_fs->fat_length);
+	for (size_t i = 0; i < FAT_CACHE_SIZE; i++) {
+		s = &fat_fs->cache[i];
+		if (s->valid && s->idx == idx) {
+			s->accessed = true;
+			return s;
+		}
+	}
+
+	for (;;) {
+		s = &fat_fs->cache[fat_fs->clock_hand];
+		fat_fs->clock_hand = (fat_fs->clock_hand + 1) % FAT_CACHE_SIZE;
+		if (!s->valid || !s->accessed)
+			break;
+		s->accessed = false;
+	}
+	fat_sector_write (s);
+	disk_read (filesys_disk, fat_fs->bs.fat_start + idx, s->entries);
+	fat_fs->read_cnt++;
+	s->idx = idx;
+	s->valid = true;
+	s->accessed = true;
+	return s;
+}
+
+/* Builds the summary of used clusters, reading the whole table once.
+ * Until an allocation needs it the summary does not exist, so that
+ * mounting reads nothing of the table. Cluster 0 is not a real
+ * cluster and always counts as used. */
+static void
+fat_build_used_map (void) {
+	if (fat_fs->used_map != NULL)
+		return;
+	fat_used_map_create ();
+	fat_fs->free_cnt = 0;
+	lock_acquire (&fat_fs->cache_lock);
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++) {
+		struct fat_sector *s = fat_sector_get (clst);
+		bool used = s->entries[clst % ENTRIES_PER_SECTOR] != 0;
+		bitmap_set (fat_fs->used_map, clst, used);
+		if (!used)
+			fat_fs->free_cnt++;
+	}
+	lock_release (&fat_fs->cache_lock);
+}
+
+/* Allocates the used map with only cluster 0, which is never handed
+ * out, marked. */
+static void
+fat_used_map_create (void) {
+	fat_fs->used_map = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->used_map == NULL)
+		PANIC ("FAT bitmap creation failed");
+	bitmap_mark (fat_fs->used_map, 0);
+}
+
+/* Writes the sectors of the table changed since the last flush. */
+void
+fat_flush (void) {
+	if (fat_fs == NULL || fat_fs->cache == NULL)
+		return;
+	lock_acquire (&fat_fs->cache_lock);
+	for (size_t i = 0; i < FAT_CACHE_SIZE; i++)
+		fat_sector_write (&fat_fs->cache[i]);
+	lock_release (&fat_fs->cache_lock);
+}
+
+/* Returns the number of free clusters from CLST on, up to MAX. */
+static size_t
+fat_free_run (cluster_t clst, size_t max) {
+	size_t n = 0;
+	while (n < max && clst + n < fat_fs->fat_length
+			&& !bitmap_test (fat_fs->used_map, clst + n))
+		n++;
+	return n;
+}
+
+/* Returns the first of CNT free clusters in a row, searching from the
+ * hint and then from the start, or BITMAP_ERROR. */
+static size_t
+fat_find_run (size_t cnt) {
+	size_t clst = bitmap_scan (fat_fs->used_map, fat_fs->last_clst, cnt, false);
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan (fat_fs->used_map, 1, cnt, false);
+	return clst;
+}
+
+/* Allocates CNT clusters and chains them after CLST, or as a new chain
+ * if CLST is 0. The clusters right after CLST are used if free, then a
+ * single free run of CNT anywhere, and unless CONTIGUOUS, smaller runs
+ * as a last resort. Returns the first new cluster, or 0 if there is not
+ * enough space, in which case nothing changed. */
+cluster_t
+fat_alloc_chain (cluster_t clst, size_t cnt, bool contiguous) {
+	cluster_t first = 0;
+	cluster_t prev = clst;
+
+	if (cnt == 0)
+		return 0;
+
+	lock_acquire (&fat_fs->write_lock);
+	fat_build_used_map ();
+	if (fat_fs->free_cnt < cnt) {
+		lock_release (&fat_fs->write_lock);
+		return 0;
+	}
+	while (cnt > 0) {
+		size_t start = prev + 1, n = 0;
+
+		/* Keep growing the chain in place. */
+		if (prev != 0)
+			n = fat_free_run (start, cnt);
+		if (contiguous && n < cnt)
+			n = 0;
+		if (n == 0) {
+			start = fat_find_run (cnt);
+			n = cnt;
+		}
+		if (start == BITMAP_ERROR) {
+			/* Fragmented: the space is there, in smaller runs. */
+			if (contiguous) {
+				lock_release (&fat_fs->write_lock);
+				return 0;
+			}
+			start = fat_find_run (1);
+			n = fat_free_run (start, cnt);
+		}
+
+		if (prev != 0)
+			fat_put (prev, start);
+		for (cluster_t c = start; c < start + n - 1; c++)
+			fat_put (c, c + 1);
+		fat_put (start + n - 1, EOChain);
+
+		if (first == 0)
+			first = start;
+		prev = start + n - 1;
+		cnt -= n;
+	}
+	fat_fs->last_clst = prev + 1 < fat_fs->fat_length ? prev + 1 : 1;
+	lock_release (&fat_fs->write_lock);
+	return first;
+}
+
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
-	/* 'clst' 뒤에다가 새로운 chain을 달아. 없으면 chain 새로 생성 */
-	cluster_t testing = fat_fs->last_clst;
-	while (fat_get (testing) != 0) {
-		testing += 1;
-		if (testing >= ROOT_DIR_CLUSTER + fat_fs->fat_length)
-			return 0;
-	}
-
-	if (clst != 0) {
-		fat_put (clst, testing);
-	}
-	fat_put (testing, EOChain);
+	return fat_alloc_chain (clst, 1, false);
+}
 
+/* Frees the CNT clusters from CLST on, whatever chain they are in. */
+void
+fat_release (cluster_t clst, size_t cnt) {
 	lock_acquire (&fat_fs->write_lock);
-	fat_fs->last_clst = testing + 1;
+	for (size_t i = 0; i < cnt; i++)
+		fat_put (clst + i, 0);
+	if (clst < fat_fs->last_clst)
+		fat_fs->last_clst = clst;
 	lock_release (&fat_fs->write_lock);
-
-	return testing;
 }
 
 /* Remove the chain of clusters starting from CLST.
@@ -221,25 +392,37 @@ fat_remove_chain (cluster_t clst, cluster_t pclst) {
 
 	cluster_t current_clst = clst;
 	cluster_t next;
+	lock_acquire (&fat_fs->write_lock);
 	while (current_clst != 0) {
 		next = fat_get (current_clst);
 		fat_put (current_clst, 0);
-		if (current_clst < fat_fs->last_clst) {
-			lock_acquire (&fat_fs->write_lock);
+		if (current_clst < fat_fs->last_clst)
 			fat_fs->last_clst = current_clst;
-			lock_release (&fat_fs->write_lock);
-		}
 		if (next == EOChain) break;
 		current_clst = next;
 	}
+	lock_release (&fat_fs->write_lock);
 }
 
-/* Update a value in the FAT table. */
+/* Update a value in the FAT table, keeping the used map in step. */
 void
 fat_put (cluster_t clst, cluster_t val) {
 	/* TODO: Your code goes here. */
 	/* clst를 val로 update. 바꿔줌. */
-	*(fat_fs->fat + clst) = val;
+	lock_acquire (&fat_fs->cache_lock);
+	struct fat_sector *s = fat_sector_get (clst);
+	bool was_used = s->entries[clst % ENTRIES_PER_SECTOR] != 0;
+	s->entries[clst % ENTRIES_PER_SECTOR] = val;
+	s->dirty = true;
+	lock_release (&fat_fs->cache_lock);
+
+	if (fat_fs->used_map != NULL && was_used != (val != 0)) {
+		bitmap_set (fat_fs->used_map, clst, val != 0);
+		if (val != 0)
+			fat_fs->free_cnt--;
+		else
+			fat_fs->free_cnt++;
+	}
 }
 
 /* Fetch a value in the FAT table. */
@@ -247,7 +430,10 @@ cluster_t
 fat_get (cluster_t clst) {
 	/* TODO: Your code goes here. */
 	/* Return in which cluster number the given cluster clst points. 음..?*/
-	return *(fat_fs->fat + clst);
+	lock_acquire (&fat_fs->cache_lock);
+	cluster_t val = fat_sector_get (clst)->entries[clst % ENTRIES_PER_SECTOR];
+	lock_release (&fat_fs->cache_lock);
+	return val;
 }
 
 /* Covert a cluster # to a sector number. */
@@ -279,4 +465,24 @@ next_sector (disk_sector_t sector) {
 	else {
 		return (sector + 1);
 	}
-}
\ No newline at end of file
+}
+
+/* Returns the cluster size of the mounted file system, in sectors. */
+unsigned int
+fat_sectors_per_cluster (void) {
+	return fat_fs->bs.sectors_per_cluster;
+}
+
+/* Prints the cluster size, the free clusters if they were counted,
+ * and the table I/O. */
+void
+fat_print_stats (void) {
+	if (fat_fs == NULL || fat_fs->cache == NULL)
+		return;
+	printf ("FAT: %u clusters of %u sectors", fat_fs->fat_length,
+			fat_fs->bs.sectors_per_cluster);
+	if (fat_fs->used_map != NULL)
+		printf (", %zu free", fat_fs->free_cnt);
+	printf (", %lld table sectors read, %lld written\n",
+			fat_fs->read_cnt, fat_fs->write_cnt);
+}
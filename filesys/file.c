@@ -2,6 +2,8 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* An open file. */ // 이거 file.h에 있어야하는거아닌가
 // struct file {
@@ -121,6 +123,35 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes at offset SRC_OFS of SRC to offset DST_OFS of DST
+ * through a kernel page, so the data never visits user memory. The
+ * positions of both files are unaffected. Returns the number of bytes
+ * copied, which is less than SIZE at the end of SRC, if DST cannot be
+ * written, or if no page is free for the copy. */
+off_t
+file_copy_range (struct file *dst, off_t dst_ofs, struct file *src,
+		off_t src_ofs, off_t size) {
+	uint8_t *buffer = palloc_get_page (0);
+	off_t bytes_copied = 0;
+
+	if (buffer == NULL)
+		return 0;
+	while (size > 0) {
+		off_t chunk = size < PGSIZE ? size : PGSIZE;
+		off_t read = inode_read_at (src->inode, buffer, chunk, src_ofs);
+		off_t written = inode_write_at (dst->inode, buffer, read, dst_ofs);
+
+		bytes_copied += written;
+		if (read < chunk || written < read)
+			break;
+		src_ofs += read;
+		dst_ofs += read;
+		size -= read;
+	}
+	palloc_free_page (buffer);
+	return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
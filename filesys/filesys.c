@@ -2,15 +2,22 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/dcache.h"
+#include "filesys/fat.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/page_cache.h"
 #include "devices/disk.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* The root directory is kept open, so that its inode and the name
+ * index built for it are not thrown away between operations. */
+static struct dir *root_dir;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -21,7 +28,10 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	page_cache_init ();
 	inode_init ();
+	dir_init ();
+	dcache_init ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -39,6 +49,10 @@ filesys_init (bool format) {
 
 	free_map_open ();
 #endif
+
+	root_dir = dir_open_root ();
+	if (root_dir == NULL)
+		PANIC ("cannot open the root directory");
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -47,11 +61,25 @@ void
 filesys_done (void) {
 	/* Original FS */
 	/*  The cache should also be written back to disk*/
+	dir_close (root_dir);
 #ifdef EFILESYS
 	fat_close ();
 #else
 	free_map_close ();
 #endif
+	page_cache_flush ();
+}
+
+/* Writes the changed parts of the FAT or free map, then every dirty
+ * cached sector, to disk. */
+void
+filesys_sync (void) {
+#ifdef EFILESYS
+	fat_flush ();
+#else
+	free_map_flush ();
+#endif
+	page_cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -1,12 +1,24 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include "filesys/fat.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct bitmap *dirty_map;     /* One bit per sector of the free map
+                                        file, set if changed since the
+                                        last flush. */
+
+/* Protects the free map and DIRTY_MAP. */
+static struct lock free_map_lock;
+
+/* Free map bits per sector of the free map file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
 
 /* Initializes the free map. */
 void
@@ -16,6 +28,20 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_size (free_map),
+				BITS_PER_SECTOR));
+	if (dirty_map == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
+	lock_init (&free_map_lock);
+}
+
+/* Notes that the bits of SECTOR through SECTOR + CNT - 1 changed. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt) {
+	if (cnt > 0)
+		bitmap_set_multiple (dirty_map, sector / BITS_PER_SECTOR,
+				(sector + cnt - 1) / BITS_PER_SECTOR
+				- sector / BITS_PER_SECTOR + 1, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,24 +50,66 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+#ifdef EFILESYS
+	/* The FAT is the free map: take a contiguous chain of clusters. */
+	cluster_t clst = 0;
+	if (cnt > 0) {
+		size_t clusters = DIV_ROUND_UP (cnt, fat_sectors_per_cluster ());
+		clst = fat_alloc_chain (0, clusters, true);
+		if (clst == 0)
+			return false;
 	}
+	*sectorp = clst != 0 ? cluster_to_sector (clst) : 0;
+	return true;
+#endif
+	lock_acquire (&free_map_lock);
+	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
 	if (sector != BITMAP_ERROR)
-		*sectorp = sector;
-	return sector != BITMAP_ERROR;
+		mark_dirty (sector, cnt);
+	lock_release (&free_map_lock);
+	if (sector == BITMAP_ERROR)
+		return false;
+	*sectorp = sector;
+	return true;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+#ifdef EFILESYS
+	if (cnt > 0)
+		fat_release (sector_to_cluster (sector),
+				DIV_ROUND_UP (cnt, fat_sectors_per_cluster ()));
+	return;
+#endif
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	mark_dirty (sector, cnt);
+	lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map changed since the last flush. */
+void
+free_map_flush (void) {
+	size_t i;
+
+	if (free_map_file == NULL)
+		return;
+	/* The free map file never grows, so writing it allocates nothing. */
+	lock_acquire (&free_map_lock);
+	for (i = 0; (i = bitmap_scan (dirty_map, i, 1, true)) != BITMAP_ERROR;
+			i++) {
+		size_t start = i * BITS_PER_SECTOR;
+		size_t cnt = bitmap_size (free_map) - start;
+		if (cnt > BITS_PER_SECTOR)
+			cnt = BITS_PER_SECTOR;
+
+		bitmap_reset (dirty_map, i);
+		if (!bitmap_write_range (free_map, free_map_file, start, cnt))
+			bitmap_mark (dirty_map, i);
+	}
+	lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,7 +125,9 @@ free_map_open (void) {
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	free_map_flush ();
 	file_close (free_map_file);
+	free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -74,4 +144,5 @@ free_map_create (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	bitmap_set_all (dirty_map, false);
 }
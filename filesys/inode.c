@@ -1,27 +1,46 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 #include "filesys/fat.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Bytes of data that fit in the inode sector itself. */
+#define INLINE_MAX (DISK_SECTOR_SIZE - 4 * sizeof (uint32_t))
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * A file of at most INLINE_MAX bytes keeps its data in the inode
+ * sector and has no data sectors, until it grows past that. */
 struct inode_disk {
 	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	uint32_t is_inline;                 /* Data is in INLINE_DATA. */
+	uint8_t inline_data[INLINE_MAX];    /* Data of an inline file. */
 };
 
-void extend_inode_if_needed (struct inode *, off_t, off_t);
+/* Most sectors an appending write allocates beyond what it needs. */
+#define PREALLOC_MAX_SECTORS 64
+
+/* Closed inodes kept in memory in case they are opened again. */
+#define CLOSED_INODES_MAX 32
+
+struct inode;
+static bool inode_reserve (struct inode *, size_t sectors, bool prealloc);
+static bool inode_uninline (struct inode *, size_t sectors, bool prealloc);
+static void inode_trim (struct inode *);
 
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
@@ -30,37 +49,230 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* Returns the number of data sectors of the file described by
+ * DISK_INODE. */
+static size_t
+data_sectors (const struct inode_disk *disk_inode) {
+	if (disk_inode->is_inline)
+		return 0;
+	return bytes_to_sectors (disk_inode->length);
+}
+
+/* Returns the number of sectors allocated on the disk for SECTORS
+ * data sectors: whole clusters under the FAT. */
+static size_t
+sectors_to_capacity (size_t sectors) {
+#ifdef EFILESYS
+	return ROUND_UP (sectors, fat_sectors_per_cluster ());
+#else
+	return sectors;
+#endif
+}
+
+/* A run of data sectors that are contiguous both in the file and on
+ * the disk. */
+struct extent {
+	size_t idx;                         /* Index of the first sector in the file. */
+	disk_sector_t sector;               /* Its sector on the disk. */
+	size_t cnt;                         /* Sectors in the run. */
+};
+
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in inode table. */
+	struct list_elem closed_elem;       /* Element in closed_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
-	int open_cnt;                       /* Number of openers. */
+	int open_cnt;                       /* Number of openers, 0 if cached. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Shared by readers, held alone by a
+	                                       writer. Protects the fields
+	                                       below. */
 	struct inode_disk data;             /* Inode content. */
+	size_t capacity;                    /* Data sectors allocated, which may
+	                                       run past the length while the
+	                                       inode is open. */
+
+	/* Cached map of the data sectors, built at open and kept up to
+	 * date by writers. Without it, sectors are found in the chain. */
+	struct extent *extents;             /* Sorted by idx. */
+	size_t extent_cnt;
+	size_t extent_cap;
+	bool extents_loaded;
+
+	struct dir_index *dir_index;        /* Name index, for a directory. */
 };
 
+/* Adds CNT sectors starting at SECTOR to the end of INODE's extent
+ * map, as file sectors IDX and up. */
+static bool
+extent_append (struct inode *inode, size_t idx, disk_sector_t sector,
+		size_t cnt) {
+	if (inode->extent_cnt > 0) {
+		struct extent *last = &inode->extents[inode->extent_cnt - 1];
+		if (last->idx + last->cnt == idx && last->sector + last->cnt == sector) {
+			last->cnt += cnt;
+			return true;
+		}
+	}
+	if (inode->extent_cnt == inode->extent_cap) {
+		size_t cap = inode->extent_cap ? inode->extent_cap * 2 : 4;
+		struct extent *extents = realloc (inode->extents,
+				cap * sizeof *extents);
+		if (extents == NULL)
+			return false;
+		inode->extents = extents;
+		inode->extent_cap = cap;
+	}
+	inode->extents[inode->extent_cnt++] = (struct extent) { idx, sector, cnt };
+	return true;
+}
+
+/* Drops INODE's extent map. */
+static void
+extents_clear (struct inode *inode) {
+	free (inode->extents);
+	inode->extents = NULL;
+	inode->extent_cnt = inode->extent_cap = 0;
+	inode->extents_loaded = false;
+}
+
+#ifdef EFILESYS
+/* Drops data sectors SECTORS and up from INODE's extent map. */
+static void
+extents_truncate (struct inode *inode, size_t sectors) {
+	while (inode->extent_cnt > 0) {
+		struct extent *last = &inode->extents[inode->extent_cnt - 1];
+		if (last->idx < sectors) {
+			if (last->idx + last->cnt > sectors)
+				last->cnt = sectors - last->idx;
+			break;
+		}
+		inode->extent_cnt--;
+	}
+}
+#endif
+
+/* Builds INODE's extent map from its cluster chain, which is walked
+ * once here instead of on every access. Returns false if memory runs
+ * out. */
+static bool
+extents_load (struct inode *inode) {
+	size_t sectors = inode->capacity;
+
+	if (inode->extents_loaded)
+		return true;
+	if (sectors > 0) {
+#ifdef EFILESYS
+		cluster_t clst = sector_to_cluster (inode->data.start);
+		unsigned int spc = fat_sectors_per_cluster ();
+		size_t idx;
+
+		/* Whole clusters, so that growing into the last one needs no
+		 * new extent. */
+		for (idx = 0; idx < sectors && clst != EOChain; clst = fat_get (clst)) {
+			if (!extent_append (inode, idx, cluster_to_sector (clst), spc)) {
+				extents_clear (inode);
+				return false;
+			}
+			idx += spc;
+		}
+#else
+		if (!extent_append (inode, 0, inode->data.start, sectors)) {
+			extents_clear (inode);
+			return false;
+		}
+#endif
+	}
+	inode->extents_loaded = true;
+	return true;
+}
+
+/* Finds sector IDX of INODE by following the cluster chain, for when
+ * the extent map cannot be built. */
+static disk_sector_t
+chain_sector (const struct inode *inode, size_t idx) {
+	disk_sector_t sector = inode->data.start;
+#ifdef EFILESYS
+	while (idx-- > 0)
+		sector = next_sector (sector);
+#else
+	sector += idx;
+#endif
+	return sector;
+}
+
+/* Returns the disk sector of data sector IDX of INODE, in
+ * O(log extents). IDX must be below INODE's capacity. */
+static disk_sector_t
+idx_to_sector (struct inode *inode, size_t idx) {
+	ASSERT (idx < inode->capacity);
+	if (!inode->extents_loaded)
+		return chain_sector (inode, idx);
+
+	/* Last extent starting at or before IDX. */
+	size_t lo = 0, hi = inode->extent_cnt;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (inode->extents[mid].idx <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	struct extent *e = &inode->extents[lo];
+	ASSERT (e->idx <= idx && idx < e->idx + e->cnt);
+	return e->sector + (idx - e->idx);
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+	return idx_to_sector (inode, pos / DISK_SECTOR_SIZE);
+}
+
+/* Table of inodes in memory, by sector, so that opening a single
+ * inode twice returns the same `struct inode'. Besides the open
+ * inodes it holds the CLOSED_INODES_MAX inodes closed last, whose
+ * sectors need not be read again if they are reopened. */
+static struct hash inodes;
+static struct list closed_inodes;   /* Oldest first. */
+static size_t closed_cnt;
+/* Protects the table, the closed list and open counts. */
+static struct lock inodes_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct inode, elem)->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!hash_init (&inodes, inode_hash, inode_less, NULL))
+		PANIC ("cannot allocate the inode table");
+	list_init (&closed_inodes);
+	lock_init (&inodes_lock);
+}
+
+/* Frees the memory of INODE, which is no longer in the table. */
+static void
+inode_free (struct inode *inode) {
+	extents_clear (inode);
+	dir_index_destroy (inode->dir_index);
+	free (inode);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -81,20 +293,22 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-				disk_sector_t target_sector = disk_inode->start;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, target_sector, zeros); 
-					target_sector = next_sector(target_sector);
-			}
+		disk_inode->is_inline = length <= (off_t) INLINE_MAX;
+
+		size_t sectors = data_sectors (disk_inode);
+		if (sectors == 0) {
+			page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			success = true;
+		} else if (free_map_allocate (sectors, &disk_inode->start)) {
+			static char zeros[DISK_SECTOR_SIZE];
+			size_t i;
+
+			page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			for (i = 0; i < sectors; i++) 
+				page_cache_write (disk_inode->start + i, zeros, 0,
+						DISK_SECTOR_SIZE);
 			success = true; 
 		} 
 		free (disk_inode);
@@ -107,39 +321,67 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
+	lock_acquire (&inodes_lock);
+
+	/* Check whether this inode is already open, or was recently. */
+	key.sector = sector;
+	e = hash_find (&inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		if (inode->open_cnt++ == 0) {
+			list_remove (&inode->closed_elem);
+			closed_cnt--;
 		}
+		lock_release (&inodes_lock);
+
+		/* Wait for the opener that is still reading it in. */
+		rwlock_acquire_read (&inode->rwlock);
+		rwlock_release_read (&inode->rwlock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize. The inode is published before its sector is read;
+	 * its own lock, not the table's, keeps others out until then. */
+	hash_insert (&inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->extents = NULL;
+	inode->extent_cnt = inode->extent_cap = 0;
+	inode->extents_loaded = false;
+	inode->dir_index = NULL;
+	rwlock_init (&inode->rwlock);
+	rwlock_acquire_write (&inode->rwlock);
+	lock_release (&inodes_lock);
+
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	inode->capacity = sectors_to_capacity (data_sectors (&inode->data));
+	extents_load (inode);
+	rwlock_release_write (&inode->rwlock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&inodes_lock);
+		ASSERT (inode->open_cnt > 0);
 		inode->open_cnt++;
+		lock_release (&inodes_lock);
+	}
 	return inode;
 }
 
@@ -150,28 +392,59 @@ inode_get_inumber (const struct inode *inode) {
 }
 
 /* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
- * If INODE was also a removed inode, frees its blocks. */
+ * If this was the last reference to INODE, keeps it among the
+ * recently closed inodes, freeing the memory of the oldest one.
+ * If INODE was also a removed inode, frees its blocks and memory. */
 void
 inode_close (struct inode *inode) {
+	struct inode *victim = NULL;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	lock_acquire (&inodes_lock);
+	if (--inode->open_cnt > 0) {
+		lock_release (&inodes_lock);
+		return;
+	}
+
+	/* Deallocate blocks if removed, or else the preallocated ones. */
+	if (inode->removed) {
+		hash_delete (&inodes, &inode->elem);
+		lock_release (&inodes_lock);
 
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			free_map_release (inode->sector, 1);
+		free_map_release (inode->sector, 1);
+		if (extents_load (inode)) {
+			for (size_t i = 0; i < inode->extent_cnt; i++)
+				free_map_release (inode->extents[i].sector,
+						inode->extents[i].cnt);
+		} else {
+			/* Out of memory for the extents: walk the disk instead. */
+#ifdef EFILESYS
+			if (inode->data.start != 0)
+				fat_remove_chain (sector_to_cluster (inode->data.start), 0);
+#else
 			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+					data_sectors (&inode->data));
+#endif
 		}
+		inode_free (inode);
+		return;
+	}
 
-		free (inode); 
+	inode_trim (inode);
+	list_push_back (&closed_inodes, &inode->closed_elem);
+	if (++closed_cnt > CLOSED_INODES_MAX) {
+		victim = list_entry (list_pop_front (&closed_inodes), struct inode,
+				closed_elem);
+		closed_cnt--;
+		hash_delete (&inodes, &victim->elem);
 	}
+	lock_release (&inodes_lock);
+
+	if (victim != NULL)
+		inode_free (victim);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -189,8 +462,18 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
+	rwlock_acquire_read (&inode->rwlock);
+	if (inode->data.is_inline) {
+		if (offset < inode_length (inode)) {
+			bytes_read = inode_length (inode) - offset;
+			if (bytes_read > size)
+				bytes_read = size;
+			memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+		}
+		rwlock_release_read (&inode->rwlock);
+		return bytes_read;
+	}
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -206,49 +489,87 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		page_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+
+	/* Start fetching the sector the next read will likely want. */
+	if (bytes_read > 0 && offset < inode_length (inode))
+		page_cache_readahead (byte_to_sector (inode, offset));
+	rwlock_release_read (&inode->rwlock);
 
 	return bytes_read;
 }
 
+/* Zeroes bytes FROM up to TO of INODE, which may hold stale data from
+ * an earlier owner of their sectors. */
+static void
+inode_zero (struct inode *inode, off_t from, off_t to) {
+	static const uint8_t zeros[DISK_SECTOR_SIZE];
+
+	while (from < to) {
+		int sector_ofs = from % DISK_SECTOR_SIZE;
+		int chunk_size = DISK_SECTOR_SIZE - sector_ofs;
+		if (chunk_size > to - from)
+			chunk_size = to - from;
+		page_cache_write (byte_to_sector (inode, from), zeros, sector_ofs,
+				chunk_size);
+		from += chunk_size;
+	}
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk is full.
+ * A write past the end of file extends the inode. The sectors for it
+ * are allocated all at once, the gap before OFFSET is zeroed, and the
+ * inode itself is written once at the end. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
+	off_t length;
 
-	if (inode->deny_write_cnt)
+	rwlock_acquire_write (&inode->rwlock);
+	if (inode->deny_write_cnt) {
+		rwlock_release_write (&inode->rwlock);
 		return 0;
+	}
+	length = inode_length (inode);
+	if (inode->data.is_inline && size > 0) {
+		if (offset + size <= (off_t) INLINE_MAX) {
+			/* Bytes between the old end and OFFSET are zero already. */
+			memcpy (inode->data.inline_data + offset, buffer, size);
+			if (offset + size > length)
+				inode->data.length = offset + size;
+			page_cache_write (inode->sector, &inode->data, 0,
+					DISK_SECTOR_SIZE);
+			rwlock_release_write (&inode->rwlock);
+			return size;
+		}
+		if (!inode_uninline (inode, bytes_to_sectors (offset + size),
+					offset >= length)) {
+			rwlock_release_write (&inode->rwlock);
+			return 0;
+		}
+	}
+	if (size > 0 && offset + size > length) {
+		if (!inode_reserve (inode, bytes_to_sectors (offset + size),
+					offset >= length)) {
+			rwlock_release_write (&inode->rwlock);
+			return 0;
+		}
+		inode->data.length = offset + size;
+		inode_zero (inode, length, offset);
+	}
 
 	while (size > 0) {
-		extend_inode_if_needed (inode, offset, size);
-
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
@@ -263,45 +584,32 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* The cache reads the sector in first unless the chunk covers
+		 * all of it. */
+		page_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
+	if (inode_length (inode) != length)
+		page_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	rwlock_release_write (&inode->rwlock);
 	return bytes_written;
 }
 
-/* Disables writes to INODE.
+/* Disables writes to INODE, once any write in progress is done.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->rwlock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->rwlock);
 }
 
 /* Re-enables writes to INODE.
@@ -309,9 +617,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->rwlock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->rwlock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -320,38 +630,139 @@ inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
 
+/* Returns the directory index kept with INODE, if any. */
+struct dir_index *
+inode_get_dir_index (const struct inode *inode) {
+	return inode->dir_index;
+}
+
+/* Keeps INDEX with INODE. It is destroyed with the inode. */
 void
-extend_inode_if_needed (struct inode *inode, off_t pos, off_t size) {
-	if (pos + size <= inode->data.length) return;
-	
-	// Add more sector only if required
-	int required_sectors = bytes_to_sectors (pos + size);
-	int current_sectors = bytes_to_sectors (inode->data.length);
-	int new_sector_cnt = required_sectors - current_sectors;
-
-	if (new_sector_cnt > 0) {
-		disk_sector_t new_sector = -1;
-		if (free_map_allocate (new_sector_cnt, &new_sector)) {
-			// New sector linking
-			if (inode->data.start == 0)
-				inode->data.start = new_sector;
-			else {
-				// Update FAT connection
-				disk_sector_t last_sector = byte_to_sector (inode, inode->data.length - 1);
-				cluster_t last_clst = sector_to_cluster (last_sector);
-				ASSERT (fat_get (last_clst) == EOChain);
-				fat_put (last_clst, sector_to_cluster (new_sector));
-			}
-		}
-		else
-			PANIC("Extend failed!");
+inode_set_dir_index (struct inode *inode, struct dir_index *index) {
+	inode->dir_index = index;
+}
+
+/* Makes sure INODE has at least SECTORS data sectors allocated.
+ * With PREALLOC, for a file growing at its end, allocates more than
+ * that: as much again as the file has, up to PREALLOC_MAX_SECTORS, so
+ * that a run of small appends allocates rarely and contiguously. The
+ * extra sectors are given back when the inode is last closed.
+ * Returns false if the disk is full. */
+static bool
+inode_reserve (struct inode *inode, size_t sectors, bool prealloc UNUSED) {
+	if (sectors <= inode->capacity)
+		return true;
+
+	/* Map the old sectors first, while the capacity still matches. */
+	extents_load (inode);
+#ifdef EFILESYS
+	/* Grow the chain, in place after its last cluster if possible. */
+	unsigned int spc = fat_sectors_per_cluster ();
+	size_t have = inode->capacity / spc;
+	size_t need = DIV_ROUND_UP (sectors, spc);
+	cluster_t last = 0;
+	cluster_t clst = 0;
+
+	if (have > 0)
+		last = sector_to_cluster (idx_to_sector (inode, inode->capacity - 1));
+	if (prealloc) {
+		size_t extra = have;
+		if (extra > PREALLOC_MAX_SECTORS / spc)
+			extra = PREALLOC_MAX_SECTORS / spc;
+		if (extra == 0)
+			extra = 1;
+		clst = fat_alloc_chain (last, need + extra - have, false);
+		if (clst != 0)
+			need += extra;
+	}
+	if (clst == 0)
+		clst = fat_alloc_chain (last, need - have, false);
+	if (clst == 0)
+		return false;
+	if (have == 0)
+		inode->data.start = cluster_to_sector (clst);
+
+	size_t idx = have * spc;
+	for (; clst != EOChain; clst = fat_get (clst)) {
+		if (inode->extents_loaded
+				&& !extent_append (inode, idx, cluster_to_sector (clst), spc))
+			extents_clear (inode);
+		idx += spc;
+	}
+	inode->capacity = need * spc;
+#else
+	size_t new_sector_cnt = sectors - inode->capacity;
+	disk_sector_t new_sector = -1;
+
+	if (!free_map_allocate (new_sector_cnt, &new_sector))
+		return false;
+	// New sector linking
+	if (inode->capacity == 0)
+		inode->data.start = new_sector;
+	else {
+		// Update FAT connection
+		disk_sector_t last_sector = idx_to_sector (inode, inode->capacity - 1);
+		cluster_t last_clst = sector_to_cluster (last_sector);
+		ASSERT (fat_get (last_clst) == EOChain);
+		fat_put (last_clst, sector_to_cluster (new_sector));
 	}
+	if (inode->extents_loaded
+			&& !extent_append (inode, inode->capacity, new_sector,
+				new_sector_cnt))
+		extents_clear (inode);
+	inode->capacity = sectors;
+#endif
+	return true;
+}
+
+/* Moves the data of INODE out of its inode sector into newly
+ * allocated data sectors, at least SECTORS of them and more with
+ * PREALLOC, as inode_reserve() does. For a write that grows the file
+ * past INLINE_MAX bytes; the caller writes the inode sector. Returns
+ * false if the disk is full. */
+static bool
+inode_uninline (struct inode *inode, size_t sectors, bool prealloc) {
+	static const uint8_t zeros[DISK_SECTOR_SIZE];
+	disk_sector_t first;
+
+	ASSERT (inode->data.is_inline);
+	ASSERT (inode->capacity == 0);
+
+	if (!inode_reserve (inode, sectors, prealloc))
+		return false;
+
+	/* A whole sector first, so that the cache does not read in what
+	 * the sector held before. */
+	first = idx_to_sector (inode, 0);
+	page_cache_write (first, zeros, 0, DISK_SECTOR_SIZE);
+	page_cache_write (first, inode->data.inline_data, 0, inode->data.length);
+	inode->data.is_inline = false;
+	memset (inode->data.inline_data, 0, sizeof inode->data.inline_data);
+	return true;
+}
 
-	// Update inode metadata
-	inode->data.length = pos + size;
-	// TODO: Should this exist only for ROOT_DIR which is zero initialized?
-	/*if (inode->data.magic != INODE_MAGIC)
-		inode->data.magic = INODE_MAGIC; */
+/* Gives back the sectors that INODE preallocated past its end. */
+static void
+inode_trim (struct inode *inode UNUSED) {
+#ifdef EFILESYS
+	unsigned int spc = fat_sectors_per_cluster ();
+	size_t have = inode->capacity / spc;
+	size_t need = DIV_ROUND_UP (data_sectors (&inode->data), spc);
 
-	disk_write (filesys_disk, inode->sector, &inode->data);
+	if (need >= have)
+		return;
+	if (need == 0) {
+		fat_remove_chain (sector_to_cluster (inode->data.start), 0);
+		inode->data.start = 0;
+		page_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	} else {
+		cluster_t last = sector_to_cluster (idx_to_sector (inode,
+					need * spc - 1));
+		fat_remove_chain (fat_get (last), last);
+	}
+	/* The inode may be reopened from the cache: forget the freed
+	 * clusters. */
+	extents_truncate (inode, need * spc);
+	inode->capacity = need * spc;
+#endif
 }
@@ -1,50 +1,280 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
-
-#include "vm/vm.h"
-static bool page_cache_readahead (struct page *page, void *kva);
-static bool page_cache_writeback (struct page *page);
-static void page_cache_destroy (struct page *page);
-
-/* DO NOT MODIFY this struct */
-static const struct page_operations page_cache_op = {
-	.swap_in = page_cache_readahead,
-	.swap_out = page_cache_writeback,
-	.destroy = page_cache_destroy,
-	.type = VM_PAGE_CACHE,
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * A fixed set of sector buffers sits between the file system and
+ * filesys_disk. Reads are served from the cache, writes only dirty the
+ * cached copy (write-behind) and are flushed by page_cache_kworkerd or
+ * at shutdown, and sequential reads queue the next sector for
+ * asynchronous read-ahead. */
+
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of cached sectors. */
+#define CACHE_SIZE 64
+
+/* Ticks between two flushes of the dirty sectors. */
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/* Read-ahead requests waiting for the daemon; more are dropped. */
+#define RA_QUEUE_SIZE 16
+
+/* One cached sector. SECTOR and VALID change only under cache_lock
+ * while PIN_CNT is 0; the data and DIRTY are protected by LOCK. */
+struct cache_entry {
+	disk_sector_t sector;
+	bool valid;                 /* Holds SECTOR (maybe still loading). */
+	bool dirty;                 /* Differs from the disk. */
+	bool accessed;              /* Used since the clock last passed. */
+	int pin_cnt;                /* Users holding or waiting for LOCK. */
+	struct lock lock;
+	uint8_t data[DISK_SECTOR_SIZE];
 };
 
+static struct cache_entry cache[CACHE_SIZE];
+static size_t clock_hand;
+/* Protects the sector of each entry, the pin counts and the hand. */
+static struct lock cache_lock;
+
+static disk_sector_t ra_queue[RA_QUEUE_SIZE];
+static size_t ra_head, ra_cnt;
+static struct lock ra_lock;
+static struct semaphore ra_sema;
+
+/* Statistics. */
+static long long hit_cnt;           /* Lookups found in the cache. */
+static long long miss_cnt;          /* Lookups that had to load. */
+static long long readahead_cnt;     /* Sectors loaded ahead of use. */
+static long long writeback_cnt;     /* Dirty sectors written back. */
+
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+static void page_cache_kworkerd (void *aux);
+static void page_cache_readaheadd (void *aux);
+
+/* Initializes the cache. Must run before the file system touches
+ * the disk through it. */
+void
+page_cache_init (void) {
+	lock_init (&cache_lock);
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		cache[i].valid = false;
+		cache[i].dirty = false;
+		cache[i].pin_cnt = 0;
+		lock_init (&cache[i].lock);
+	}
+	lock_init (&ra_lock);
+	sema_init (&ra_sema, 0);
+
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	thread_create ("readahead", PRI_DEFAULT, page_cache_readaheadd, NULL);
+}
+
+/* Returns the entry holding SECTOR, or NULL.
+ * cache_lock must be held. */
+static struct cache_entry *
+cache_find (disk_sector_t sector) {
+	for (size_t i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Picks an unpinned entry to reuse with the clock algorithm, or
+ * returns NULL if every entry is in use. cache_lock must be held. */
+static struct cache_entry *
+cache_victim (void) {
+	for (size_t i = 0; i < 2 * CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_SIZE;
+		if (e->pin_cnt > 0)
+			continue;
+		if (!e->valid)
+			return e;
+		if (e->accessed) {
+			e->accessed = false;
+			continue;
+		}
+		return e;
+	}
+	return NULL;
+}
+
+/* Writes E back if it is dirty. E's lock must be held. */
+static void
+cache_write_back (struct cache_entry *e) {
+	if (e->dirty) {
+		disk_write (filesys_disk, e->sector, e->data);
+		e->dirty = false;
+		writeback_cnt++;
+	}
+}
+
+/* Returns the entry of SECTOR, pinned and locked. A missing sector is
+ * read from the disk if LOAD, and otherwise left for the caller to
+ * overwrite completely. For a read-ahead, returns NULL instead if the
+ * sector is cached already. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool load, bool readahead) {
+	struct cache_entry *e;
+
+	for (;;) {
+		lock_acquire (&cache_lock);
+		e = cache_find (sector);
+		if (e != NULL) {
+			if (readahead) {
+				lock_release (&cache_lock);
+				return NULL;
+			}
+			e->pin_cnt++;
+			hit_cnt++;
+			lock_release (&cache_lock);
+			lock_acquire (&e->lock);
+			e->accessed = true;
+			return e;
+		}
+
+		e = cache_victim ();
+		if (e == NULL) {
+			lock_release (&cache_lock);
+			thread_yield ();
+			continue;
+		}
+		if (e->valid && e->dirty) {
+			/* Clean the victim before giving up its sector, so that
+			 * nobody reads that sector from the disk too early. */
+			e->pin_cnt++;
+			lock_release (&cache_lock);
+			lock_acquire (&e->lock);
+			cache_write_back (e);
+			lock_release (&e->lock);
+			lock_acquire (&cache_lock);
+			e->pin_cnt--;
+			lock_release (&cache_lock);
+			continue;
+		}
+
+		if (readahead)
+			readahead_cnt++;
+		else
+			miss_cnt++;
+		e->sector = sector;
+		e->valid = true;
+		e->pin_cnt = 1;
+		/* Unpinned, so the lock is free. Whoever looks SECTOR up now
+		 * waits for it until the data is there. */
+		lock_acquire (&e->lock);
+		lock_release (&cache_lock);
+		if (load)
+			disk_read (filesys_disk, sector, e->data);
+		e->accessed = true;
+		return e;
+	}
+}
+
+/* Unlocks and unpins E. */
+static void
+cache_put (struct cache_entry *e) {
+	lock_release (&e->lock);
+	lock_acquire (&cache_lock);
+	e->pin_cnt--;
+	lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes at offset OFS of SECTOR into BUFFER. */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_read (disk_sector_t sector, void *buffer, off_t ofs, size_t size) {
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	struct cache_entry *e = cache_get (sector, true, false);
+	memcpy (buffer, e->data + ofs, size);
+	cache_put (e);
 }
 
-/* Initialize the page cache */
-bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
-	/* Set up the handler */
-	page->operations = &page_cache_op;
+/* Copies SIZE bytes from BUFFER to offset OFS of SECTOR. The sector
+ * reaches the disk later. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size) {
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
 
+	bool full = ofs == 0 && size == DISK_SECTOR_SIZE;
+	struct cache_entry *e = cache_get (sector, !full, false);
+	memcpy (e->data + ofs, buffer, size);
+	e->dirty = true;
+	cache_put (e);
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
-static bool
-page_cache_readahead (struct page *page, void *kva) {
+/* Asks for SECTOR to be loaded in the background. */
+void
+page_cache_readahead (disk_sector_t sector) {
+	lock_acquire (&ra_lock);
+	if (ra_cnt < RA_QUEUE_SIZE) {
+		ra_queue[(ra_head + ra_cnt) % RA_QUEUE_SIZE] = sector;
+		ra_cnt++;
+		sema_up (&ra_sema);
+	}
+	lock_release (&ra_lock);
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
-static bool
-page_cache_writeback (struct page *page) {
+/* Writes every dirty sector back to the disk. */
+void
+page_cache_flush (void) {
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+
+		lock_acquire (&cache_lock);
+		if (!e->valid || !e->dirty) {
+			lock_release (&cache_lock);
+			continue;
+		}
+		e->pin_cnt++;
+		lock_release (&cache_lock);
+		lock_acquire (&e->lock);
+		cache_write_back (e);
+		cache_put (e);
+	}
 }
 
-/* Destory the page_cache. */
+/* Prints cache statistics. */
+void
+page_cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld read-ahead, "
+			"%lld write-behind\n",
+			hit_cnt, miss_cnt, readahead_cnt, writeback_cnt);
+}
+
+/* Loads the sectors queued by page_cache_readahead(). */
 static void
-page_cache_destroy (struct page *page) {
+page_cache_readaheadd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+
+		sema_down (&ra_sema);
+		lock_acquire (&ra_lock);
+		sector = ra_queue[ra_head];
+		ra_head = (ra_head + 1) % RA_QUEUE_SIZE;
+		ra_cnt--;
+		lock_release (&ra_lock);
+
+		struct cache_entry *e = cache_get (sector, true, true);
+		if (e != NULL)
+			cache_put (e);
+	}
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache: writes dirty sectors behind, along
+ * with the changed file system metadata. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FLUSH_INTERVAL);
+		filesys_sync ();
+	}
 }
@@ -0,0 +1,18 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Child sector of a negative entry: the name is known not to exist. */
+#define DCACHE_NOENT ((disk_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
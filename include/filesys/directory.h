@@ -12,8 +12,10 @@
 #define NAME_MAX 14
 
 struct inode;
+struct dir_index;
 
 /* Opening and closing directories. */
+void dir_init (void);
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
@@ -27,4 +29,6 @@ bool dir_add (struct dir *, const char *name, disk_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
 
+void dir_index_destroy (struct dir_index *);
+
 #endif /* filesys/directory.h */
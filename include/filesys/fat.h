@@ -14,15 +14,19 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define EOChain 0x0FFFFFFF   /* End of cluster chain */
 
 /* Sectors of FAT information. */
-#define SECTORS_PER_CLUSTER 1 /* Number of sectors per cluster */
+#define SECTORS_PER_CLUSTER 1 /* Default number of sectors per cluster */
+#define FAT_MAX_CLUSTER_SECTORS 64 /* Largest cluster size -f accepts */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
+/* Cluster size used by the next format, set by the -f=N option. */
+extern unsigned int fat_format_cluster_sectors;
+
 void fat_init (void);
 void fat_open (void);
 void fat_close (void);
 void fat_create (void);
-void fat_close (void);
+void fat_flush (void);
 
 cluster_t fat_create_chain (
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
@@ -31,11 +35,15 @@ void fat_remove_chain (
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
+cluster_t fat_alloc_chain (cluster_t clst, size_t cnt, bool contiguous);
+void fat_release (cluster_t clst, size_t cnt);
 cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
 
 cluster_t sector_to_cluster (disk_sector_t sector);
 disk_sector_t next_sector (disk_sector_t sector);
+unsigned int fat_sectors_per_cluster (void);
+void fat_print_stats (void);
 
 #endif /* filesys/fat.h */
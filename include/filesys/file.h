@@ -28,6 +28,8 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_copy_range (struct file *dst, off_t dst_ofs, struct file *src,
+		off_t src_ofs, off_t size);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
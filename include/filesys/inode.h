@@ -6,6 +6,7 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct dir_index;
 
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
@@ -19,5 +20,7 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+struct dir_index *inode_get_dir_index (const struct inode *);
+void inode_set_dir_index (struct inode *, struct dir_index *);
 
 #endif /* filesys/inode.h */
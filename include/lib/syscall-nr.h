@@ -36,6 +36,25 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Paging hints. */
+	SYS_MADVISE,                /* Advise the VM about a memory range. */
+	SYS_MSYNC,                  /* Write a memory mapping back to its file. */
+
+	/* Memory accounting. */
+	SYS_MEMSTAT,                /* Get the memory usage of the process. */
+	SYS_RSSLIMIT,               /* Limit the resident pages of the process. */
+
+	/* Process creation. */
+	SYS_SPAWN,                  /* Start a new process running a file. */
+
+	/* Positioned and vectored I/O. */
+	SYS_PREAD,                  /* Read at an offset, keeping the position. */
+	SYS_PWRITE,                 /* Write at an offset, keeping the position. */
+	SYS_READV,                  /* Read into several buffers. */
+	SYS_WRITEV,                 /* Write from several buffers. */
+	SYS_COPY_FILE_RANGE,        /* Copy between files in the kernel. */
+	SYS_SENDFILE,               /* Copy a file to a file or the console. */
 };
 
 #endif /* lib/syscall-nr.h */
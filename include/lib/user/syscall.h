@@ -13,6 +13,41 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Or'd into the WRITABLE argument of mmap() to share the mapping with
+   every other MAP_SHARED mapping of the file and with forked children.
+   With fd -1 the mapping is shared anonymous memory. */
+#define MAP_SHARED 0x2
+
+/* Flags for msync(). Both MS_ASYNC and MS_SYNC write back at once. */
+#define MS_ASYNC 1              /* Start writing back. */
+#define MS_INVALIDATE 2         /* Accepted, mappings are always coherent. */
+#define MS_SYNC 4               /* Write back before returning. */
+
+/* Advice values for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access; no readahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Will be accessed soon; load now. */
+#define MADV_DONTNEED 4         /* Not needed; drop the contents. */
+
+/* Memory usage of a process in pages, filled in by memstat(). */
+struct memstat {
+	size_t resident;            /* Pages in memory, but not MAP_SHARED ones. */
+	size_t swapped;             /* Anonymous pages in swap. */
+	size_t file;                /* Resident pages of file mappings. */
+	size_t rss_limit;           /* Limit set by rsslimit(), 0 for none. */
+	size_t merged;              /* Pages sharing a frame with identical ones. */
+};
+
+/* One buffer of readv() or writev(). */
+struct iovec {
+	void *iov_base;             /* Start of the buffer. */
+	size_t iov_len;             /* Bytes in the buffer. */
+};
+
+/* Most buffers that readv() and writev() accept. */
+#define IOV_MAX 1024
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -25,6 +60,7 @@ void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
 int exec (const char *file);
+pid_t spawn (const char *file, char *const argv[]);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -37,10 +73,21 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int pread (int fd, void *buffer, unsigned length, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned length, off_t offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int in_fd, off_t *in_off, int out_fd, off_t *out_off,
+		size_t length);
+int sendfile (int out_fd, int in_fd, off_t *offset, size_t count);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length, int flags);
+int memstat (struct memstat *st);
+int rsslimit (size_t pages);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -2,11 +2,31 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
+/* Past this many pages a gather flushes the whole TLB at once. */
+#define TLB_GATHER_MAX 32
+
+/* Collects the TLB invalidations of the active page table between
+ * tlb_gather_begin() and tlb_gather_end(), instead of issuing an
+ * invlpg for every PTE change. User code must not run in between. */
+struct tlb_gather {
+	uint64_t *pml4;
+	size_t cnt;                 /* Pages in PAGES, or ... */
+	bool full;                  /* ... more than fit: flush everything. */
+	const void *pages[TLB_GATHER_MAX];
+};
+
+void tlb_gather_begin (struct tlb_gather *, uint64_t *pml4);
+void tlb_gather_end (struct tlb_gather *);
+
+extern bool pml4_use_pcid;
+
+void pml4_tlb_init (void);
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
@@ -14,9 +34,13 @@ void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_split_huge_page (uint64_t *pml4, void *upage);
+void pml4_print_stats (void);
 void pml4_clear_page (uint64_t *pml4, void *upage);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
+void pml4_set_writable (uint64_t *pml4, const void *upage, bool writable);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
 void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
 
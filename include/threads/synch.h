@@ -42,6 +42,23 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. Any number of readers, or one writer. Waiting
+ * writers keep new readers out, so that they are not starved. */
+struct rwlock {
+	struct lock lock;           /* Protects the fields below. */
+	struct condition can_read;
+	struct condition can_write;
+	int readers;                /* Readers holding the lock. */
+	int waiting_writers;        /* Writers waiting for the lock. */
+	struct thread *writer;      /* Writer holding the lock, or NULL. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 
 
 /* Optimization barrier.
@@ -122,10 +122,12 @@ struct thread {
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct tlb_gather *tlb;             /* Active TLB gather, or NULL. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	size_t rss_limit;                   /* Resident pages allowed, 0 for any. */
 
 	void * stack_bottom;
 #endif
@@ -3,9 +3,13 @@
 
 #include "threads/thread.h"
 
+/* Most words in a command line, program name included. */
+#define PROCESS_ARGS_MAX 29
+
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+tid_t process_spawn (char *cmd_line);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
@@ -9,9 +9,17 @@ enum vm_type;
 struct anon_page {
     struct thread* owner;
     size_t swap_slot_idx;
+    struct ksm_node *ksm;       /* Node of the shared frame if merged. */
+    struct list_elem ksm_elem;  /* Element in ksm->mappers. */
+    bool file_backed;           /* Loaded from the executable. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_discard (struct page *page);
+size_t swap_write_page (const void *kva);
+void swap_read_page (size_t swap_slot_idx, void *kva);
+void swap_copy_page (size_t swap_slot_idx, void *kva);
+void swap_free_slot (size_t swap_slot_idx);
 
 #endif
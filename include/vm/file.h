@@ -5,6 +5,7 @@
 
 
 struct page;
+struct vm_area;
 enum vm_type;
 
 struct file_page {
@@ -24,5 +25,9 @@ void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
+void *do_mmap_shared (void *addr, size_t length, int writable,
+		struct file *file, off_t offset);
 void do_munmap (void *va);
+void mmap_sync (struct vm_area *vma, void *start, void *end);
+struct page *mmap_populate_page (struct vm_area *vma, void *va);
 #endif
@@ -0,0 +1,31 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <hash.h>
+#include <list.h>
+
+struct frame;
+struct page;
+
+/* Same-page merging.
+ * A kernel thread looks at writable anonymous pages that have not been
+ * written for a while and lets pages with identical contents share one
+ * read-only frame. The first write to a merged page gives it a private
+ * copy again, see vm_handle_wp(). Merged frames are not on the eviction
+ * clock. */
+struct ksm_node {
+	struct frame *frame;        /* The shared, read-only frame. */
+	uint64_t hash;              /* Hash of the contents. */
+	struct list mappers;        /* Pages mapping the frame (anon.ksm_elem). */
+	struct hash_elem elem;      /* Element in the stable table. */
+};
+
+/* Pages scanned every KSM_INTERVAL, 0 to disable merging. */
+extern int ksm_scan_pages;
+
+void ksm_init (void);
+void ksm_leave (struct page *page);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
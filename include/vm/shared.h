@@ -0,0 +1,61 @@
+#ifndef VM_SHARED_H
+#define VM_SHARED_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/synch.h"
+#include "filesys/off_t.h"
+
+struct file;
+struct inode;
+struct frame;
+struct page;
+struct thread;
+struct vm_area;
+
+/* Memory behind MAP_SHARED mappings.
+ * Every shared mapping of a file uses the one object of that file, and
+ * a shared anonymous mapping has an object of its own that fork hands
+ * on to the child. Mappings of the same object map the same frames, so
+ * a write through one of them is seen by all the others at once. */
+struct shm_object {
+	struct inode *inode;        /* Identity of a file object, NULL if anon. */
+	struct file *file;          /* Handle used for I/O, NULL if anon. */
+	struct hash slots;          /* struct shm_slot, by offset. */
+	int ref_cnt;                /* vm_areas referring to the object. */
+	struct lock lock;           /* Protects slots and their mappers. */
+	struct list_elem elem;      /* Element in the list of file objects. */
+};
+
+/* One page of a shared object. */
+struct shm_slot {
+	struct shm_object *obj;
+	off_t ofs;                  /* Byte offset within the object. */
+	struct frame *frame;        /* Resident frame, or NULL. */
+	size_t swap_slot_idx;       /* Swap slot of an evicted anon page. */
+	bool dirty;                 /* Written since the last writeback. */
+	struct list mappers;        /* Pages mapping this slot (shared.elem). */
+	struct hash_elem elem;      /* Element in obj->slots. */
+};
+
+/* Per-page data of a page in a shared mapping. */
+struct shared_page {
+	struct shm_slot *slot;
+	struct thread *owner;       /* Process whose pml4 maps the page. */
+	struct list_elem elem;      /* Element in slot->mappers. */
+};
+
+void shm_init (void);
+struct shm_object *shm_object_open (struct file *file);
+struct shm_object *shm_object_create (void);
+struct shm_object *shm_object_reopen (struct shm_object *obj);
+void shm_object_close (struct shm_object *obj);
+
+struct page *shm_populate_page (struct vm_area *vma, void *va);
+bool shm_slot_load (struct shm_slot *slot, void *kva);
+bool shm_slot_evict (struct shm_slot *slot);
+void shm_slot_sync (struct shm_slot *slot);
+bool shm_slot_test_accessed (struct shm_slot *slot);
+
+#endif /* vm/shared.h */
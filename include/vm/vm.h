@@ -16,6 +16,8 @@ enum vm_type {
 	VM_FILE = 2,
 	/* page that hold the page cache, for project 4 */
 	VM_PAGE_CACHE = 3,
+	/* page of a MAP_SHARED mapping, backed by a shm_object */
+	VM_SHARED = 4,
 
 	/* Bit flags to store state */
 
@@ -31,6 +33,9 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
+#include "vm/shared.h"
+#include "vm/ksm.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -56,6 +61,10 @@ struct page {
 	struct hash_elem hash_elem;
 	bool writable;
 
+	/* mmap region this page was faulted in from, NULL otherwise. */
+	struct vm_area *vma;
+	struct list_elem vma_elem;
+
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -64,6 +73,7 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct shared_page shared;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
@@ -77,6 +87,14 @@ struct page {
 struct frame {
 	void *kva;	// the kernel virtual address
 	struct page *page;
+	/* Slot owning the frame if it holds a shared page; PAGE is NULL then. */
+	struct shm_slot *shm;
+	struct thread *owner;   /* Process whose pml4 maps PAGE. */
+	int pin_cnt;            /* Never evicted while positive. */
+	bool busy;              /* Off the clock, being evicted or scanned. */
+	/* Node of a frame shared by merged pages; PAGE is NULL then and the
+	 * frame is not on the clock. */
+	struct ksm_node *ksm;
 
 	// You are allowed to add more members as you implement a frame management interface.
 	// 보통 리스트로 넣으려나?
@@ -107,6 +125,27 @@ struct page_operations {
 struct supplemental_page_table {
 	// 각 thread, process들의 table
 	struct hash* page_table;
+	/* mmap regions. Pages inside them are created on first fault. */
+	struct vma_table vmas;
+	/* Tick at which vm_periodic_writeback() flushes the regions next. */
+	int64_t next_writeback;
+	/* Pages of the process on the eviction clock; changed under its
+	 * lock. Frames of MAP_SHARED objects are not charged to anyone. */
+	size_t resident_cnt;
+	size_t file_cnt;            /* Of which file-backed. */
+	/* 2MB region last found not to qualify for a huge page, so that
+	 * faults in it skip the check, or NULL. */
+	void *huge_miss;
+};
+
+/* Memory usage of a process in pages, as returned by memstat().
+ * Matches struct memstat of lib/user/syscall.h. */
+struct vm_stat {
+	size_t resident;
+	size_t swapped;
+	size_t file;
+	size_t rss_limit;
+	size_t merged;
 };
 
 #include "threads/thread.h"
@@ -118,6 +157,10 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct page *spt_populate_page (struct supplemental_page_table *spt,
+		const void *va);
+bool spt_range_is_free (struct supplemental_page_table *spt,
+		void *start, void *end);
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -130,6 +173,21 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
+struct frame *vm_frame_detach (struct frame **framep);
+void vm_free_frame (struct frame *frame);
+struct frame *vm_pin_page (struct page *page);
+void vm_unpin_frame (struct frame *frame);
+bool vm_pin_buffer (const void *buffer, size_t size, bool write);
+void vm_unpin_buffer (const void *buffer, size_t size);
+struct frame *vm_frame_isolate (bool (*pick) (struct frame *));
+void vm_frame_putback (struct frame *frame);
+void vm_frame_done (struct frame *frame);
+void vm_print_stats (void);
+void vm_get_stat (struct vm_stat *st);
+void vm_set_rss_limit (size_t pages);
+bool vm_madvise (void *addr, size_t length, int advice);
+bool vm_msync (void *addr, size_t length);
+void vm_periodic_writeback (void);
 
 
 // project3- Memory Management
@@ -0,0 +1,66 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <list.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct page;
+struct shm_object;
+
+/* mmap() flag asking for a MAP_SHARED mapping. Matches MAP_SHARED of
+ * lib/user/syscall.h. */
+#define MAP_SHARED 0x2
+
+/* msync() flags, matching lib/user/syscall.h. */
+#define MS_ASYNC 1
+#define MS_INVALIDATE 2
+#define MS_SYNC 4
+
+/* Paging hints given through madvise(). The values match the MADV_*
+ * constants of lib/user/syscall.h. */
+enum vm_advice {
+	VM_ADV_NORMAL = 0,
+	VM_ADV_RANDOM = 1,
+	VM_ADV_SEQUENTIAL = 2,
+	VM_ADV_WILLNEED = 3,
+	VM_ADV_DONTNEED = 4,
+};
+
+/* A virtual memory area: one contiguous mmap region of a process.
+ * The area only describes the mapping (file, offset, protection).
+ * `struct page`s are created on the first fault into the area and
+ * are linked into PAGES so that munmap only visits the pages that
+ * were actually touched. */
+struct vm_area {
+	void *start;                /* First page of the region. */
+	void *end;                  /* One past the last page of the region. */
+	struct file *file;          /* Backing file, owned by the area. */
+	struct shm_object *obj;     /* Object of a MAP_SHARED area, or NULL. */
+	off_t offset;               /* File offset mapped at START. */
+	size_t length;              /* Bytes of the file that are mapped. */
+	bool writable;
+	enum vm_advice advice;      /* Access pattern hint, see vm_madvise(). */
+	struct list pages;          /* Materialized pages (page->vma_elem). */
+};
+
+/* Per-process set of areas, kept sorted by start address so that
+ * lookups are a binary search. */
+struct vma_table {
+	struct vm_area **areas;
+	size_t cnt;
+	size_t cap;
+};
+
+void vma_table_init (struct vma_table *);
+void vma_table_destroy (struct vma_table *);
+struct vm_area *vma_find (struct vma_table *, const void *va);
+struct vm_area *vma_next (struct vma_table *, const void *va);
+bool vma_overlaps (struct vma_table *, const void *start, const void *end);
+struct vm_area *vma_insert (struct vma_table *, void *start, size_t length,
+		struct file *file, off_t offset, bool writable);
+void vma_remove (struct vma_table *, struct vm_area *);
+bool vma_table_copy_shared (struct vma_table *dst, struct vma_table *src);
+
+#endif /* vm/vma.h */
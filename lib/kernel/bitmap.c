@@ -326,6 +326,23 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the bytes of B that hold bits START through START + CNT - 1
+   to FILE, where bitmap_write() would put them.  Return true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+		size_t start, size_t cnt) {
+	off_t ofs, end;
+
+	ASSERT (start <= b->bit_cnt);
+	ASSERT (start + cnt <= b->bit_cnt);
+
+	ofs = start / CHAR_BIT;
+	end = DIV_ROUND_UP (start + cnt, CHAR_BIT);
+	return file_write_at (file, (uint8_t *) b->bits + ofs, end - ofs, ofs)
+		== end - ofs;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,48 @@
+/* Child process for syn-read-own test.
+   Reads its own test file ROUNDS times, a block at a time, and
+   checks the contents. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-read-own.h"
+
+const char *test_name = "child-syn-own";
+
+static char buf[FILE_SIZE];
+static char block[BLOCK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd, round;
+  size_t ofs;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, file_name_fmt, child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < sizeof buf; ofs += BLOCK_SIZE)
+        {
+          CHECK (read (fd, block, BLOCK_SIZE) == BLOCK_SIZE,
+                 "read \"%s\"", file_name);
+          compare_bytes (block, buf + ofs, BLOCK_SIZE, ofs, file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
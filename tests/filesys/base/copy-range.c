@@ -0,0 +1,53 @@
+/* Copies a file inside the kernel twice: with copy_file_range()
+   between the two file positions, and with sendfile() from an
+   explicit offset, which must leave the source position alone.
+   Then checks both copies. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (256 * 1024)
+#define BLOCK_SIZE 4096
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int src, dst, fd;
+  off_t ofs;
+
+  CHECK (create ("src", sizeof buf), "create \"src\"");
+  CHECK ((fd = open ("src")) > 1, "open \"src\"");
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf, "write \"src\"");
+  msg ("close \"src\"");
+  close (fd);
+
+  CHECK ((src = open ("src")) > 1, "open \"src\"");
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((dst = open ("dst")) > 1, "open \"dst\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += BLOCK_SIZE)
+    if (copy_file_range (src, NULL, dst, NULL, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("copy_file_range at offset %d failed", ofs);
+  CHECK (copy_file_range (src, NULL, dst, NULL, BLOCK_SIZE) == 0,
+         "copy_file_range at end of \"src\"");
+  msg ("close \"dst\"");
+  close (dst);
+
+  CHECK (create ("out", 0), "create \"out\"");
+  CHECK ((fd = open ("out")) > 1, "open \"out\"");
+  ofs = 0;
+  while (ofs < FILE_SIZE)
+    if (sendfile (fd, src, &ofs, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("sendfile at offset %d failed", ofs);
+  CHECK (tell (src) == FILE_SIZE, "tell \"src\" after sendfile");
+  msg ("close \"out\"");
+  close (fd);
+  close (src);
+
+  check_file ("dst", buf, sizeof buf);
+  check_file ("out", buf, sizeof buf);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-range) begin
+(copy-range) create "src"
+(copy-range) open "src"
+(copy-range) write "src"
+(copy-range) close "src"
+(copy-range) open "src"
+(copy-range) create "dst"
+(copy-range) open "dst"
+(copy-range) copy_file_range at end of "src"
+(copy-range) close "dst"
+(copy-range) create "out"
+(copy-range) open "out"
+(copy-range) tell "src" after sendfile
+(copy-range) close "out"
+(copy-range) open "dst" for verification
+(copy-range) verified contents of "dst"
+(copy-range) close "dst"
+(copy-range) open "out" for verification
+(copy-range) verified contents of "out"
+(copy-range) close "out"
+(copy-range) end
+EOF
+pass;
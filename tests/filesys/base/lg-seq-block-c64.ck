@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "File system was not formatted with 64-sector clusters.\n"
+  if !grep (/^FAT: \d+ clusters of 64 sectors/, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-seq-block-c64) begin
+(lg-seq-block-c64) create "noodle"
+(lg-seq-block-c64) open "noodle"
+(lg-seq-block-c64) writing "noodle"
+(lg-seq-block-c64) close "noodle"
+(lg-seq-block-c64) open "noodle" for verification
+(lg-seq-block-c64) verified contents of "noodle"
+(lg-seq-block-c64) close "noodle"
+(lg-seq-block-c64) end
+EOF
+pass;
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "File system was not formatted with 8-sector clusters.\n"
+  if !grep (/^FAT: \d+ clusters of 8 sectors/, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-seq-block-c8) begin
+(lg-seq-block-c8) create "noodle"
+(lg-seq-block-c8) open "noodle"
+(lg-seq-block-c8) writing "noodle"
+(lg-seq-block-c8) close "noodle"
+(lg-seq-block-c8) open "noodle" for verification
+(lg-seq-block-c8) verified contents of "noodle"
+(lg-seq-block-c8) close "noodle"
+(lg-seq-block-c8) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Spawns 4 child processes, each of which reads a file of its
+   own over and over and makes sure that the contents are what
+   they should be. The files are unrelated, so the reads can
+   proceed in the file system at the same time. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-read-own.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char file_name[16];
+  int fd, i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, file_name_fmt, i);
+      CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      random_init (i);
+      random_bytes (buf, sizeof buf);
+      CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+             "write \"%s\"", file_name);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+
+  exec_children ("child-syn-own", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
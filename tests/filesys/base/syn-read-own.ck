@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-read-own) begin
+(syn-read-own) create "conc0"
+(syn-read-own) open "conc0"
+(syn-read-own) write "conc0"
+(syn-read-own) close "conc0"
+(syn-read-own) create "conc1"
+(syn-read-own) open "conc1"
+(syn-read-own) write "conc1"
+(syn-read-own) close "conc1"
+(syn-read-own) create "conc2"
+(syn-read-own) open "conc2"
+(syn-read-own) write "conc2"
+(syn-read-own) close "conc2"
+(syn-read-own) create "conc3"
+(syn-read-own) open "conc3"
+(syn-read-own) write "conc3"
+(syn-read-own) close "conc3"
+(syn-read-own) exec child 1 of 4: "child-syn-own 0"
+(syn-read-own) exec child 2 of 4: "child-syn-own 1"
+(syn-read-own) exec child 3 of 4: "child-syn-own 2"
+(syn-read-own) exec child 4 of 4: "child-syn-own 3"
+(syn-read-own) wait for child 1 of 4 returned 0 (expected 0)
+(syn-read-own) wait for child 2 of 4 returned 1 (expected 1)
+(syn-read-own) wait for child 3 of 4 returned 2 (expected 2)
+(syn-read-own) wait for child 4 of 4 returned 3 (expected 3)
+(syn-read-own) end
+EOF
+pass;
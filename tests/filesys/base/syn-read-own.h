@@ -0,0 +1,13 @@
+#ifndef TESTS_FILESYS_BASE_SYN_READ_OWN_H
+#define TESTS_FILESYS_BASE_SYN_READ_OWN_H
+
+#define CHILD_CNT 4
+#define FILE_SIZE (128 * 1024)
+#define BLOCK_SIZE 4096
+#define ROUNDS 8
+
+/* Each child reads a file of its own, filled with random bytes
+   seeded by the child's index. */
+static const char file_name_fmt[] = "conc%d";
+
+#endif /* tests/filesys/base/syn-read-own.h */
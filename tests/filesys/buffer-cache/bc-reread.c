@@ -0,0 +1,37 @@
+/* Reads a file that fits in the buffer cache twice and checks that
+   the second pass is served without touching the disk. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#define TEST_SIZE (16 * 1024)
+
+static const char file_name[] = "data";
+static char buf[TEST_SIZE];
+static char copy[TEST_SIZE];
+
+void
+test_main (void) {
+  long long read_cnt;
+  int fd, pass;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == TEST_SIZE, "write \"%s\"", file_name);
+  close (fd);
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      read_cnt = get_fs_disk_read_cnt ();
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      CHECK (read (fd, copy, sizeof copy) == TEST_SIZE,
+             "read \"%s\"", file_name);
+      if (memcmp (buf, copy, sizeof buf))
+        fail ("file content mismatch");
+      close (fd);
+    }
+  CHECK (get_fs_disk_read_cnt () == read_cnt, "check read_cnt");
+}
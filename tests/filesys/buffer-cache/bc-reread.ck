@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-reread) begin
+(bc-reread) create "data"
+(bc-reread) open "data"
+(bc-reread) write "data"
+(bc-reread) open "data"
+(bc-reread) read "data"
+(bc-reread) open "data"
+(bc-reread) read "data"
+(bc-reread) check read_cnt
+(bc-reread) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Appends to a file, closes it, lets another file take the clusters
+   freed at close, then reopens the first file and appends to it
+   again. Checks that both files are intact. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 1000
+#define CHUNK_CNT 10
+#define FILE_SIZE (2 * CHUNK_SIZE * CHUNK_CNT)
+#define OTHER_SIZE 8000
+static char buf_a[FILE_SIZE];
+static char buf_b[OTHER_SIZE];
+
+/* Appends CHUNK_CNT chunks of BUF_A to "a", starting at OFS. */
+static void
+append_chunks (size_t ofs) 
+{
+  int fd, i;
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  seek (fd, ofs);
+  for (i = 0; i < CHUNK_CNT; i++, ofs += CHUNK_SIZE)
+    if (write (fd, buf_a + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("write %d bytes at offset %zu in \"a\" failed", CHUNK_SIZE, ofs);
+  msg ("close \"a\"");
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_init (0);
+  random_bytes (buf_a, sizeof buf_a);
+  random_bytes (buf_b, sizeof buf_b);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  append_chunks (0);
+
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd = open ("b")) > 1, "open \"b\"");
+  CHECK (write (fd, buf_b, sizeof buf_b) == OTHER_SIZE, "write \"b\"");
+  msg ("close \"b\"");
+  close (fd);
+
+  append_chunks (CHUNK_SIZE * CHUNK_CNT);
+
+  check_file ("a", buf_a, sizeof buf_a);
+  check_file ("b", buf_b, sizeof buf_b);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-reopen) begin
+(grow-reopen) create "a"
+(grow-reopen) open "a"
+(grow-reopen) close "a"
+(grow-reopen) create "b"
+(grow-reopen) open "b"
+(grow-reopen) write "b"
+(grow-reopen) close "b"
+(grow-reopen) open "a"
+(grow-reopen) close "a"
+(grow-reopen) open "a" for verification
+(grow-reopen) verified contents of "a"
+(grow-reopen) close "a"
+(grow-reopen) open "b" for verification
+(grow-reopen) verified contents of "b"
+(grow-reopen) close "b"
+(grow-reopen) end
+EOF
+pass;
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-root-xl) begin
+(grow-root-xl) created 10000 files
+(grow-root-xl) opened 10000 files
+(grow-root-xl) removed 10000 files
+(grow-root-xl) end
+EOF
+pass;
@@ -0,0 +1,5 @@
+/* Grows a file from 0 bytes to 524,288 bytes, 1,234 bytes at a
+   time, across many preallocated clusters. */
+
+#define TEST_SIZE 524288
+#include "tests/filesys/extended/grow-seq.inc"
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-seq-xl) begin
+(grow-seq-xl) create "testme"
+(grow-seq-xl) open "testme"
+(grow-seq-xl) writing "testme"
+(grow-seq-xl) close "testme"
+(grow-seq-xl) open "testme" for verification
+(grow-seq-xl) verified contents of "testme"
+(grow-seq-xl) close "testme"
+(grow-seq-xl) end
+EOF
+pass;
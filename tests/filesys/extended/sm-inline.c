@@ -0,0 +1,67 @@
+/* Writes 1,000 files of 200 bytes each, small enough to be kept
+   in their inode sectors, reads them all back, then removes
+   them. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+#define FILE_SIZE 200
+
+/* Fills BUF with the contents of file I. */
+static void
+fill (char *buf, int i) 
+{
+  int j;
+
+  for (j = 0; j < FILE_SIZE; j++)
+    buf[j] = i + j;
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  char expected[FILE_SIZE], actual[FILE_SIZE];
+  int fd, i;
+
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "s%d", i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      fill (expected, i);
+      CHECK (write (fd, expected, FILE_SIZE) == FILE_SIZE,
+             "write \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+  msg ("wrote %d files", FILE_CNT);
+
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "s%d", i);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      fill (expected, i);
+      CHECK (read (fd, actual, FILE_SIZE) == FILE_SIZE, "read \"%s\"", name);
+      if (memcmp (actual, expected, FILE_SIZE))
+        fail ("\"%s\" has wrong contents", name);
+      close (fd);
+    }
+  quiet = false;
+  msg ("read %d files", FILE_CNT);
+
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "s%d", i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+  msg ("removed %d files", FILE_CNT);
+}
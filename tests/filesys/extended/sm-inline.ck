@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-inline) begin
+(sm-inline) wrote 1000 files
+(sm-inline) read 1000 files
+(sm-inline) removed 1000 files
+(sm-inline) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Reads and writes "sample.txt" with pread() and pwrite() and checks
+   that neither moves the file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  seek (handle, 10);
+
+  byte_cnt = pread (handle, buf, sizeof sample - 1, 0);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("pread() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (buf, sample, sizeof sample - 1))
+    fail ("pread() read wrong data");
+  if (tell (handle) != 10)
+    fail ("pread() moved the position to %u", tell (handle));
+
+  msg ("pwrite \"sample.txt\"");
+  byte_cnt = pwrite (handle, "KAIST", 5, 20);
+  if (byte_cnt != 5)
+    fail ("pwrite() returned %d instead of 5", byte_cnt);
+  if (tell (handle) != 10)
+    fail ("pwrite() moved the position to %u", tell (handle));
+
+  memcpy (sample + 20, "KAIST", 5);
+  check_file ("sample.txt", sample, sizeof sample - 1);
+}
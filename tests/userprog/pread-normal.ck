@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-normal) begin
+(pread-normal) open "sample.txt"
+(pread-normal) pwrite "sample.txt"
+(pread-normal) open "sample.txt" for verification
+(pread-normal) verified contents of "sample.txt"
+(pread-normal) close "sample.txt"
+(pread-normal) end
+pread-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Reads "sample.txt" into three buffers with readv() and writes two
+   buffers to the console with writev(). */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char a[7], b[50], c[sizeof sample];
+  struct iovec iov[3] = {
+    { a, sizeof a },
+    { b, sizeof b },
+    { c, sizeof c },
+  };
+  struct iovec out[2] = {
+    { "(readv-normal) written ", 23 },
+    { "by writev\n", 10 },
+  };
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  byte_cnt = readv (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (a, sample, sizeof a)
+      || memcmp (b, sample + sizeof a, sizeof b)
+      || memcmp (c, sample + sizeof a + sizeof b,
+                 sizeof sample - 1 - sizeof a - sizeof b))
+    fail ("readv() read wrong data");
+  if (tell (handle) != sizeof sample - 1)
+    fail ("readv() left the position at %u", tell (handle));
+
+  byte_cnt = writev (STDOUT_FILENO, out, 2);
+  if (byte_cnt != 33)
+    fail ("writev() returned %d instead of 33", byte_cnt);
+}
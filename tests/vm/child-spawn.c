@@ -0,0 +1,8 @@
+/* Child process run by spawn-many.
+   Exits at once, with the number of arguments it was given. */
+
+int
+main (int argc, char *argv[] __attribute__ ((unused)))
+{
+  return argc;
+}
@@ -0,0 +1,63 @@
+/* Fills many pages with a few distinct patterns, waits for the merging
+   daemon to share them, then writes to some merged pages and checks
+   that the writes stay private, in this process and in a child. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 64
+#define PATTERNS 4
+#define SPINS 2000000
+
+static char buf[PAGES][4096];
+
+static void
+check (int skip)
+{
+  int i;
+
+  for (i = 0; i < PAGES; i++)
+    {
+      char want = i == skip ? 'x' : 'a' + i % PATTERNS;
+      if (buf[i][0] != want || buf[i][4095] != want)
+        fail ("page %d has wrong data", i);
+    }
+}
+
+void
+test_main (void)
+{
+  struct memstat st;
+  pid_t child;
+  int i;
+
+  for (i = 0; i < PAGES; i++)
+    memset (buf[i], 'a' + i % PATTERNS, sizeof buf[i]);
+
+  for (i = 0; i < SPINS; i++)
+    {
+      memstat (&st);
+      if (st.merged >= PAGES / 2)
+        break;
+    }
+  if (i == SPINS)
+    fail ("only %zu pages merged", st.merged);
+  msg ("pages merged");
+
+  /* Writing to a merged page must not show through its twins. */
+  memset (buf[5], 'x', sizeof buf[5]);
+  check (5);
+  msg ("write is private");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      memset (buf[9], 'y', sizeof buf[9]);
+      exit (buf[1][0] == 'b' && buf[9][0] == 'y' ? 81 : -1);
+    }
+  CHECK (wait (child) == 81, "child sees its own write");
+  check (5);
+  msg ("parent unaffected");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-merge) begin
+(ksm-merge) pages merged
+(ksm-merge) write is private
+(ksm-merge) child sees its own write
+(ksm-merge) parent unaffected
+(ksm-merge) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Exercises madvise() on anonymous memory and on a file mapping:
+   WILLNEED keeps the contents, DONTNEED zeroes anonymous pages and
+   drops file pages that are read back from the file, and
+   SEQUENTIAL reads ahead without changing what is seen. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/large.inc"
+
+#define PAGE_SIZE 4096
+#define SIZE (16 * PAGE_SIZE)
+
+static char buf[SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  int handle;
+  size_t i;
+
+  memset (buf, 0x5a, SIZE);
+  CHECK (madvise (buf, SIZE, MADV_WILLNEED) == 0, "madvise WILLNEED");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu changed by WILLNEED", i);
+
+  CHECK (madvise (buf, SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu not zero after DONTNEED", i);
+
+  CHECK (madvise (buf + 1, PAGE_SIZE, MADV_WILLNEED) == -1,
+         "madvise misaligned address");
+  CHECK (madvise (buf, PAGE_SIZE, 42) == -1, "madvise bad advice");
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (mmap (map, SIZE, 1, handle, 0) == map, "mmap \"large.txt\"");
+  CHECK (madvise (map, SIZE, MADV_SEQUENTIAL) == 0, "madvise SEQUENTIAL");
+  if (memcmp (map, large, SIZE))
+    fail ("read of sequential mapping reported bad data");
+
+  CHECK (madvise (map, SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED mapping");
+  if (memcmp (map, large, SIZE))
+    fail ("read after DONTNEED reported bad data");
+
+  munmap (map);
+  close (handle);
+}
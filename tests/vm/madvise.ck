@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise WILLNEED
+(madvise) madvise DONTNEED
+(madvise) madvise misaligned address
+(madvise) madvise bad advice
+(madvise) open "large.txt"
+(madvise) mmap "large.txt"
+(madvise) madvise SEQUENTIAL
+(madvise) madvise DONTNEED mapping
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Writes to a file mapping, flushes it with msync() and checks with
+   read() that the file changed while the mapping is still in place. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  static const char overwrite[] = "msync was here";
+  char *actual = (char *) 0x10000000;
+  char buf[sizeof overwrite - 1];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 1, handle, 0) == actual, "mmap \"sample.txt\"");
+  memcpy (actual, overwrite, sizeof buf);
+
+  CHECK (msync (actual, 4096, MS_ASYNC | MS_SYNC) == -1, "msync bad flags");
+  CHECK (msync (actual, 4096, MS_SYNC) == 0, "msync");
+
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == (int) sizeof buf, "read \"sample.txt\"");
+  if (memcmp (buf, overwrite, sizeof buf))
+    fail ("msync did not write the mapping back");
+  if (memcmp (actual + sizeof buf, sample + sizeof buf,
+              strlen (sample) - sizeof buf))
+    fail ("mapping changed by msync");
+
+  munmap (actual);
+  close (handle);
+}
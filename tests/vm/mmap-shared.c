@@ -0,0 +1,47 @@
+/* Checks that MAP_SHARED mappings map the same memory: two shared
+   mappings of one file see each other's writes, and a shared
+   anonymous mapping is shared with a forked child. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *a = (char *) 0x10000000;
+  char *b = (char *) 0x20000000;
+  char *anon = (char *) 0x30000000;
+  int handle;
+  pid_t pid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (a, 4096, 1 | MAP_SHARED, handle, 0) == a, "mmap \"sample.txt\" at a");
+  CHECK (mmap (b, 4096, 1 | MAP_SHARED, handle, 0) == b, "mmap \"sample.txt\" at b");
+  if (memcmp (b, sample, strlen (sample)))
+    fail ("read of shared mapping reported bad data");
+  a[0] = '#';
+  if (b[0] != '#')
+    fail ("write through a not seen through b");
+  munmap (a);
+  munmap (b);
+  close (handle);
+
+  CHECK (mmap (anon, 4096, 1 | MAP_SHARED, -1, 0) == anon, "mmap shared anonymous");
+  if (anon[0] != 0)
+    fail ("shared anonymous memory is not zeroed");
+  strlcpy (anon, "parent", 4096);
+  if ((pid = fork ("child")) == 0)
+    {
+      if (strcmp (anon, "parent"))
+        fail ("child does not see parent's data");
+      strlcpy (anon, "child", 4096);
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  if (strcmp (anon, "child"))
+    fail ("parent does not see child's data");
+  munmap (anon);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) open "sample.txt"
+(mmap-shared) mmap "sample.txt" at a
+(mmap-shared) mmap "sample.txt" at b
+(mmap-shared) mmap shared anonymous
+(mmap-shared) wait for child
+(mmap-shared) end
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Touches one page of a 2 MB aligned window inside a large
+   zero-initialized buffer, and verifies that the whole window
+   was mapped at once by a physically contiguous huge page and
+   that its contents are correct. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define SIZE (2 * HUGE_SIZE)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  char *window = (char *) (((uintptr_t) buf + HUGE_SIZE - 1)
+                           & ~(uintptr_t) (HUGE_SIZE - 1));
+  uintptr_t base;
+  size_t i;
+
+  msg ("touch window");
+  window[0] = 0x5a;
+
+  msg ("check physical layout");
+  base = (uintptr_t) get_phys_addr (window);
+  for (i = 0; i < HUGE_SIZE; i += PAGE_SIZE)
+    if ((uintptr_t) get_phys_addr (window + i) != base + i)
+      fail ("page at offset %zu is not part of the huge page", i);
+
+  msg ("check contents");
+  for (i = 1; i < HUGE_SIZE; i++)
+    if (window[i] != 0)
+      fail ("byte %zu != 0", i);
+  memset (window, 0xa5, HUGE_SIZE);
+  for (i = 0; i < HUGE_SIZE; i++)
+    if (window[i] != (char) 0xa5)
+      fail ("byte %zu != 0xa5", i);
+}
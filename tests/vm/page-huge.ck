@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) touch window
+(page-huge) check physical layout
+(page-huge) check contents
+(page-huge) end
+EOF
+pass;
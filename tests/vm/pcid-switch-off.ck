@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($switches, $flushes)
+  = map (/^TLB: PCID off, (\d+) address space switches, (\d+) flushed/,
+	 @output);
+fail "PCIDs were used despite -no-pcid.\n" if !defined ($switches);
+fail "$switches address space switches but $flushes TLB flushes.\n"
+  if $flushes != $switches;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pcid-switch-off) begin
+(pcid-switch-off) start 4 processes
+(pcid-switch-off) done
+(pcid-switch-off) end
+EOF
+pass;
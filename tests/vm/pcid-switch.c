@@ -0,0 +1,50 @@
+/* Several processes share the CPU while each keeps walking its own
+   working set, so the address space is switched over and over, and
+   checks that every process sees only its own writes. Also built as
+   pcid-switch-off, which runs with the -no-pcid kernel option. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PROCS 4
+#define PAGES 64
+#define ROUNDS 20000
+
+static char ws[PAGES * 4096];
+
+static void
+walk (void)
+{
+  int round, page;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (page = 0; page < PAGES; page++)
+      ws[page * 4096]++;
+  for (page = 0; page < PAGES; page++)
+    if (ws[page * 4096] != (char) ROUNDS)
+      fail ("page %d has wrong count", page);
+}
+
+void
+test_main (void)
+{
+  pid_t pids[PROCS - 1];
+  int i;
+
+  msg ("start %d processes", PROCS);
+  for (i = 0; i < PROCS - 1; i++)
+    {
+      pids[i] = fork ("worker");
+      if (pids[i] == 0)
+        {
+          walk ();
+          exit (0);
+        }
+    }
+  walk ();
+  for (i = 0; i < PROCS - 1; i++)
+    if (wait (pids[i]) != 0)
+      fail ("worker %d failed", i);
+  msg ("done");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($switches, $flushes)
+  = map (/^TLB: PCID on, (\d+) address space switches, (\d+) flushed/, @output);
+fail "Every address space switch flushed the TLB.\n"
+  if defined ($switches) && $flushes >= $switches;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pcid-switch) begin
+(pcid-switch) start 4 processes
+(pcid-switch) done
+(pcid-switch) end
+EOF
+pass;
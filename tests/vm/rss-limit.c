@@ -0,0 +1,46 @@
+/* Limits the process to a few resident pages, touches many more,
+   and checks that the process stays within the limit, swapping its
+   own pages out, and that a forked child inherits the limit. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 128
+#define LIMIT 32
+
+static char buf[PAGES * 4096];
+
+void
+test_main (void)
+{
+  struct memstat st;
+  pid_t child;
+  int i;
+
+  CHECK (rsslimit (LIMIT) == 0, "limit to %d pages", LIMIT);
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = i;
+
+  CHECK (memstat (&st) == 0, "memstat");
+  if (st.rss_limit != LIMIT)
+    fail ("limit is %zu pages", st.rss_limit);
+  if (st.resident > LIMIT)
+    fail ("%zu pages resident", st.resident);
+  if (st.swapped < PAGES - LIMIT)
+    fail ("only %zu pages swapped", st.swapped);
+  msg ("resident pages within the limit");
+
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) i)
+      fail ("page %d has wrong data", i);
+  msg ("data intact");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      memstat (&st);
+      exit (st.resident <= LIMIT ? (int) st.rss_limit : -1);
+    }
+  CHECK (wait (child) == LIMIT, "child inherited the limit");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) limit to 32 pages
+(rss-limit) memstat
+(rss-limit) resident pages within the limit
+(rss-limit) data intact
+(rss-limit) child inherited the limit
+(rss-limit) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* A parent with a large resident address space starts a
+   short-lived child with spawn() over and over, and checks that
+   each child got its arguments and that the parent's memory is
+   left alone. Also checks that spawn() of a missing file fails. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 512
+#define ROUNDS 64
+
+static char buf[PAGES * 4096];
+
+void
+test_main (void)
+{
+  char *argv[] = {"child-spawn", "a", "b", NULL};
+  int i, page;
+
+  for (page = 0; page < PAGES; page++)
+    buf[page * 4096] = (char) page;
+
+  CHECK (spawn ("no-such-file", NULL) == -1, "spawn \"no-such-file\"");
+
+  msg ("start %d children", ROUNDS);
+  for (i = 0; i < ROUNDS; i++)
+    {
+      pid_t pid = spawn ("child-spawn", argv);
+      if (pid < 0)
+        fail ("child %d not started", i);
+      if (wait (pid) != 3)
+        fail ("child %d did not get its arguments", i);
+    }
+
+  for (page = 0; page < PAGES; page++)
+    if (buf[page * 4096] != (char) page)
+      fail ("page %d has wrong data", page);
+  msg ("done");
+}
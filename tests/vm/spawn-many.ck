@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(spawn-many) begin
+(spawn-many) spawn "no-such-file"
+(spawn-many) start 64 children
+(spawn-many) done
+(spawn-many) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Several processes keep touching more anonymous memory than fits
+   in the user pool, so they evict each other's pages all the time,
+   and each also read()s a file straight into its paged-out buffer.
+   Checks that every process gets its own data back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PROCS 8
+#define PAGES 256
+#define ROUNDS 4
+#define CHUNK 16384
+
+static char buf[PAGES * 4096];
+static char chunk[CHUNK];
+
+static void
+work (int id)
+{
+  int round, page, fd;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      for (page = 0; page < PAGES; page++)
+        buf[page * 4096] = (char) (id * 31 + round * 7 + page);
+
+      /* The tail of BUF was likely evicted by now: read() into it. */
+      fd = open ("large.txt");
+      if (fd < 0)
+        fail ("open \"large.txt\"");
+      if (read (fd, buf + sizeof buf - CHUNK, CHUNK) != CHUNK)
+        fail ("read \"large.txt\"");
+      close (fd);
+      if (memcmp (buf + sizeof buf - CHUNK, chunk, CHUNK))
+        fail ("process %d read wrong data", id);
+
+      for (page = 0; page < PAGES - CHUNK / 4096; page++)
+        if (buf[page * 4096] != (char) (id * 31 + round * 7 + page))
+          fail ("process %d: page %d has wrong data", id, page);
+    }
+}
+
+void
+test_main (void)
+{
+  pid_t pids[PROCS];
+  int fd, i;
+
+  CHECK ((fd = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (read (fd, chunk, CHUNK) == CHUNK, "read \"large.txt\"");
+  close (fd);
+
+  msg ("start %d processes", PROCS);
+  for (i = 0; i < PROCS; i++)
+    {
+      pids[i] = fork ("worker");
+      if (pids[i] == 0)
+        {
+          work (i);
+          exit (0);
+        }
+    }
+  for (i = 0; i < PROCS; i++)
+    if (wait (pids[i]) != 0)
+      fail ("worker %d failed", i);
+  msg ("done");
+}
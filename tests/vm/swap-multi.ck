@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+my ($evicted) = map (/^Frames: (\d+) evicted/, @output);
+fail "No page was evicted.\n" if !$evicted;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-multi) begin
+(swap-multi) open "large.txt"
+(swap-multi) read "large.txt"
+(swap-multi) start 8 processes
+(swap-multi) done
+(swap-multi) end
+EOF
+pass;
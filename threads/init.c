@@ -34,8 +34,11 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/dcache.h"
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/page_cache.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -155,7 +158,8 @@ paging_init (uint64_t mem_end) {
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		/* Kernel mappings are the same in every address space. */
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -164,6 +168,7 @@ paging_init (uint64_t mem_end) {
 	}
 
 	// reload cr3
+	pml4_tlb_init ();
 	pml4_activate(0);
 }
 
@@ -214,13 +219,28 @@ parse_options (char **argv) {
 		else if (!strcmp (name, "-q"))
 			power_off_when_done = true;
 #ifdef FILESYS
-		else if (!strcmp (name, "-f"))
+		else if (!strcmp (name, "-f")) {
 			format_filesys = true;
+			/* A plain -f keeps a cluster size given before. */
+			if (value != NULL) {
+				int spc = atoi (value);
+				if (spc < 1 || spc > FAT_MAX_CLUSTER_SECTORS)
+					PANIC ("cluster size must be 1 to %d sectors",
+							FAT_MAX_CLUSTER_SECTORS);
+				fat_format_cluster_sectors = spc;
+			}
+		}
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-no-pcid"))
+			pml4_use_pcid = false;
+#ifdef VM
+		else if (!strcmp (name, "-ksm"))
+			ksm_scan_pages = atoi (value);
+#endif
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -323,11 +343,16 @@ usage (void) {
 			"\nOptions:\n"
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
-			"  -f                 Format file system disk during startup.\n"
+			"  -f[=N]             Format file system disk during startup,\n"
+			"                     with FAT clusters of N sectors (default 1).\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -no-pcid           Flush the TLB on every address space switch.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -ksm=PAGES         Merge identical pages, scanning PAGES every 100 ms.\n"
 #endif
 			);
 	power_off ();
@@ -356,10 +381,17 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	page_cache_print_stats ();
+	dcache_print_stats ();
+	fat_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
+	pml4_print_stats ();
 }
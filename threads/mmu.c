@@ -1,13 +1,45 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Huge page statistics. */
+static long long huge_mapped_cnt;   /* # of 2MB PDEs installed. */
+static long long huge_split_cnt;    /* # split back into 4kB PTEs. */
+static long long huge_freed_cnt;    /* # freed while still huge. */
+
+/* TLB tagging.
+ * With CR4.PCIDE each page table gets a process-context identifier
+ * (PCID) that tags its TLB entries, so switching address spaces does
+ * not flush the TLB. PCID 0 belongs to base_pml4, and kernel mappings
+ * are global, so they survive every CR3 load anyway. PCIDs are handed
+ * out round-robin. A PCID that changes owner, or whose page table loses
+ * a mapping while not active, is marked stale and flushed on its next
+ * activation. */
+#define PCID_CNT 64
+#define CR3_NOFLUSH (1ULL << 63)
+#define CR4_PGE (1 << 7)
+#define CR4_PCIDE (1 << 17)
+#define CPUID_1_EDX_PGE (1 << 13)
+#define CPUID_1_ECX_PCID (1 << 17)
+
+bool pml4_use_pcid = true;          /* Cleared by -no-pcid or the CPU. */
+static uint64_t *pcid_owner[PCID_CNT];
+static bool pcid_stale[PCID_CNT];
+static unsigned pcid_next = 1;
+
+static long long as_switch_cnt;     /* # of CR3 loads. */
+static long long tlb_flush_cnt;     /* # of CR3 loads that flushed. */
+static long long invlpg_cnt;        /* # of single page invalidations. */
+static long long gather_flush_cnt;  /* # of gathers ended by a full flush. */
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -23,6 +55,9 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
+		/* A huge page has no page table; the PDE is the entry. */
+		if (pdp[idx] & PTE_PS)
+			return &pdp[idx];
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
@@ -88,6 +123,137 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the page directory entry for VA in PML4, creating the
+ * upper level tables if CREATE is true.  Unlike pml4e_walk(), this
+ * stops one level above the page tables. */
+static uint64_t *
+pde_walk (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *table = pml4;
+	unsigned idx[2] = { PML4 (va), PDPE (va) };
+
+	for (int level = 0; level < 2; level++) {
+		uint64_t *entry = &table[idx[level]];
+		if (!(*entry & PTE_P)) {
+			if (!create)
+				return NULL;
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*entry));
+	}
+	return &table[PDX (va)];
+}
+
+/* Enables global pages and, unless disabled, PCIDs if the CPU has
+ * them. Called once while the loader's page table is still active. */
+void
+pml4_tlb_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t cr4 = rcr4 ();
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_1_EDX_PGE)
+		cr4 |= CR4_PGE;
+	if (!(ecx & CPUID_1_ECX_PCID))
+		pml4_use_pcid = false;
+	if (pml4_use_pcid)
+		cr4 |= CR4_PCIDE;
+	lcr4 (cr4);
+}
+
+/* Returns the PCID of PML4, or 0 if it has none. */
+static unsigned
+pcid_of (uint64_t *pml4) {
+	for (unsigned pcid = 1; pcid < PCID_CNT; pcid++)
+		if (pcid_owner[pcid] == pml4)
+			return pcid;
+	return 0;
+}
+
+/* Gives PML4 the next PCID, taking it from its previous owner. */
+static unsigned
+pcid_assign (uint64_t *pml4) {
+	enum intr_level old_level = intr_disable ();
+	unsigned pcid = pcid_next;
+
+	pcid_next = pcid_next % (PCID_CNT - 1) + 1;
+	pcid_owner[pcid] = pml4;
+	pcid_stale[pcid] = true;
+	intr_set_level (old_level);
+	return pcid;
+}
+
+/* Starts gathering the invalidations of PML4, the active page table.
+ * A gather begun while another one is active is folded into the
+ * outer one. */
+void
+tlb_gather_begin (struct tlb_gather *tlb, uint64_t *pml4) {
+	tlb->pml4 = pml4;
+	tlb->cnt = 0;
+	tlb->full = false;
+#ifdef USERPROG
+	struct thread *curr = thread_current ();
+	if (curr->tlb == NULL)
+		curr->tlb = tlb;
+#endif
+}
+
+/* Performs the invalidations gathered in TLB: one invlpg per page, or
+ * a single CR3 reload if there were too many. */
+void
+tlb_gather_end (struct tlb_gather *tlb) {
+#ifdef USERPROG
+	struct thread *curr = thread_current ();
+	if (curr->tlb != tlb)
+		return;
+	curr->tlb = NULL;
+#endif
+	if (tlb->full) {
+		/* Without the no-flush bit this drops every non-global entry of
+		 * the current PCID. */
+		lcr3 (rcr3 ());
+		gather_flush_cnt++;
+	} else
+		for (size_t i = 0; i < tlb->cnt; i++) {
+			invlpg ((uint64_t) tlb->pages[i]);
+			invlpg_cnt++;
+		}
+}
+
+/* Records VA in TLB, or gives up on single pages when it is full. */
+static void
+tlb_gather_add (struct tlb_gather *tlb, const void *va) {
+	if (tlb->full)
+		return;
+	if (tlb->cnt == TLB_GATHER_MAX)
+		tlb->full = true;
+	else
+		tlb->pages[tlb->cnt++] = va;
+}
+
+/* Drops the TLB entry that PML4 may hold for VA, or leaves it to the
+ * active gather. */
+static void
+pml4_invalidate (uint64_t *pml4, const void *va) {
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4)) {
+#ifdef USERPROG
+		struct tlb_gather *tlb = thread_current ()->tlb;
+		if (tlb != NULL && tlb->pml4 == pml4) {
+			tlb_gather_add (tlb, va);
+			return;
+		}
+#endif
+		invlpg ((uint64_t) va);
+		invlpg_cnt++;
+	} else if (pml4_use_pcid) {
+		unsigned pcid = pcid_of (pml4);
+		if (pcid != 0)
+			pcid_stale[pcid] = true;
+	}
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -95,8 +261,11 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 uint64_t *
 pml4_create (void) {
 	uint64_t *pml4 = palloc_get_page (0);
-	if (pml4)
+	if (pml4) {
 		memcpy (pml4, base_pml4, PGSIZE);
+		if (pml4_use_pcid)
+			pcid_assign (pml4);
+	}
 	return pml4;
 }
 
@@ -122,10 +291,18 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+		if (((uint64_t) pte) & PTE_P) {
+			if (pdp[i] & PTE_PS) {
+				/* Huge page: FUNC sees the PDE once, at its base. */
+				void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+									 ((uint64_t) pdp_index << PDPESHIFT) |
+									 ((uint64_t) i << PDXSHIFT));
+				if (!func (&pdp[i], va, aux))
+					return false;
+			} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
+		}
 	}
 	return true;
 }
@@ -169,8 +346,13 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+		if (((uint64_t) pte) & PTE_P) {
+			if (pdp[i] & PTE_PS) {
+				palloc_free_multiple ((void *) PTE_ADDR (pte), HUGE_PGCNT);
+				huge_freed_cnt++;
+			} else
+				pt_destroy (PTE_ADDR (pte));
+		}
 	}
 	palloc_free_page ((void *) pdp);
 }
@@ -192,6 +374,12 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
+	if (pml4_use_pcid) {
+		unsigned pcid = pcid_of (pml4);
+		if (pcid != 0)
+			pcid_owner[pcid] = NULL;
+	}
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
@@ -203,7 +391,25 @@ pml4_destroy (uint64_t *pml4) {
  * register. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	uint64_t cr3 = vtop (pml4 ? pml4 : base_pml4);
+
+	as_switch_cnt++;
+	if (pml4_use_pcid) {
+		unsigned pcid = 0;
+		if (pml4 != NULL && pml4 != base_pml4) {
+			pcid = pcid_of (pml4);
+			if (pcid == 0)
+				pcid = pcid_assign (pml4);
+		}
+		cr3 |= pcid;
+		if (pcid_stale[pcid]) {
+			pcid_stale[pcid] = false;
+			tlb_flush_cnt++;
+		} else
+			cr3 |= CR3_NOFLUSH;
+	} else
+		tlb_flush_cnt++;
+	lcr3 (cr3);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -216,8 +422,12 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
-	if (pte && (*pte & PTE_P))
+	if (pte && (*pte & PTE_P)) {
+		if (*pte & PTE_PS)
+			return ptov (PTE_ADDR (*pte))
+				+ ((uint64_t) uaddr & (HUGE_PGSIZE - 1));
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+	}
 	return NULL;
 }
 
@@ -238,11 +448,77 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte && (*pte & PTE_PS))
+		return false;
+	if (pte) {
+		bool present = (*pte & PTE_P) != 0;
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		/* Replacing a live mapping: drop the stale translation. */
+		if (present)
+			pml4_invalidate (pml4, upage);
+	}
 	return pte != NULL;
 }
 
+/* Maps the 2MB user region at UPAGE to the physically contiguous
+ * block at KPAGE with a single PDE.  Both must be 2MB aligned, and
+ * nothing may be mapped in the region yet (not even an empty page
+ * table).  Returns false if that is not the case or if memory
+ * allocation fails. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT ((uint64_t) upage % HUGE_PGSIZE == 0);
+	ASSERT ((uint64_t) kpage % HUGE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pde_walk (pml4, (uint64_t) upage, 1);
+	if (pde == NULL || (*pde & PTE_P))
+		return false;
+
+	*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	huge_mapped_cnt++;
+	return true;
+}
+
+/* If UPAGE lies in a huge page, replaces the huge mapping by a page
+ * table of 512 4kB entries mapping the same frames with the same
+ * permission, accessed and dirty bits.  Returns false only if the page
+ * table cannot be allocated. */
+bool
+pml4_split_huge_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde = pde_walk (pml4, (uint64_t) upage, 0);
+	if (pde == NULL || (*pde & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+		return true;
+
+	uint64_t *pt = palloc_get_page (0);
+	if (pt == NULL)
+		return false;
+
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+	for (unsigned i = 0; i < HUGE_PGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+
+	/* invlpg drops the 2MB TLB entry covering the address. */
+	pml4_invalidate (pml4, huge_round_down (upage));
+	huge_split_cnt++;
+	return true;
+}
+
+/* Prints huge page statistics. */
+void
+pml4_print_stats (void) {
+	printf ("Paging: %lld huge pages in use, %lld mapped, %lld split\n",
+			huge_mapped_cnt - huge_split_cnt - huge_freed_cnt,
+			huge_mapped_cnt, huge_split_cnt);
+	printf ("TLB: PCID %s, %lld address space switches, %lld flushed\n",
+			pml4_use_pcid ? "on" : "off", as_switch_cnt, tlb_flush_cnt);
+	printf ("TLB: %lld invlpg, %lld gathers flushed in full\n",
+			invlpg_cnt, gather_flush_cnt);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -253,12 +529,14 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
+	/* Only this 4kB page goes away, so a huge mapping must be split. */
+	if (!pml4_split_huge_page (pml4, upage))
+		PANIC ("out of memory splitting huge page");
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		pml4_invalidate (pml4, upage);
 	}
 }
 
@@ -276,6 +554,8 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
  * in PML4. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
+	if (!pml4_split_huge_page (pml4, (void *) vpage))
+		PANIC ("out of memory splitting huge page");
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
 	if (pte) {
 		if (dirty)
@@ -283,8 +563,24 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		pml4_invalidate (pml4, vpage);
+	}
+}
+
+/* Makes the PTE for virtual page VPAGE in PML4 writable or read-only,
+ * keeping it present. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	if (!pml4_split_huge_page (pml4, (void *) vpage))
+		PANIC ("out of memory splitting huge page");
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+
+		pml4_invalidate (pml4, vpage);
 	}
 }
 
@@ -309,7 +605,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		pml4_invalidate (pml4, vpage);
 	}
 }
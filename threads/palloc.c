@@ -284,6 +284,38 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* Like palloc_get_multiple(), but the first page returned is
+   aligned to a multiple of ALIGN_CNT pages.  Used for huge page
+   mappings, which need a physically contiguous, aligned block. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt, size_t align_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t pool_pages = bitmap_size (pool->used_map);
+	size_t page_idx = BITMAP_ERROR;
+	void *pages = NULL;
+
+	ASSERT (align_cnt > 0);
+
+	lock_acquire (&pool->lock);
+	for (size_t idx = (align_cnt - pg_no (pool->base) % align_cnt) % align_cnt;
+			idx + page_cnt <= pool_pages; idx += align_cnt)
+		if (bitmap_none (pool->used_map, idx, page_cnt)) {
+			bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+			page_idx = idx;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (page_idx != BITMAP_ERROR) {
+		pages = pool->base + PGSIZE * page_idx;
+		if (flags & PAL_ZERO)
+			memset (pages, 0, PGSIZE * page_cnt);
+	} else if (flags & PAL_ASSERT)
+		PANIC ("palloc_get: out of pages");
+
+	return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -361,6 +361,70 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 		cond_signal (cond, lock);
 }
 
+/* Initializes RW as an unheld readers-writer lock. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	cond_init (&rw->can_read);
+	cond_init (&rw->can_write);
+	rw->readers = 0;
+	rw->waiting_writers = 0;
+	rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or waits
+ * for it. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	while (rw->writer != NULL || rw->waiting_writers > 0)
+		cond_wait (&rw->can_read, &rw->lock);
+	rw->readers++;
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, held for reading by the current thread. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	lock_acquire (&rw->lock);
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0)
+		cond_signal (&rw->can_write, &rw->lock);
+	lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until nobody else holds it. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	lock_acquire (&rw->lock);
+	rw->waiting_writers++;
+	while (rw->writer != NULL || rw->readers > 0)
+		cond_wait (&rw->can_write, &rw->lock);
+	rw->waiting_writers--;
+	rw->writer = thread_current ();
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, held for writing by the current thread. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	lock_acquire (&rw->lock);
+	ASSERT (rw->writer == thread_current ());
+	rw->writer = NULL;
+	if (rw->waiting_writers > 0)
+		cond_signal (&rw->can_write, &rw->lock);
+	else
+		cond_broadcast (&rw->can_read, &rw->lock);
+	lock_release (&rw->lock);
+}
+
 // bool sema_compare_priority (struct list_elem *l, struct list_elem *s, void *aux UNUSED)
 bool sema_compare_priority (const struct list_elem *l, const struct list_elem *s, void *aux UNUSED)
 {
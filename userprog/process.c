@@ -26,6 +26,9 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void __do_spawn (void *);
+static bool duplicate_fds (struct thread *parent);
+static bool process_load (char *file_name, struct intr_frame *if_);
 void load_userStack(char **argv, int argc, void **rspp);
 
 /* General process initializer for initd and other process. */
@@ -96,6 +99,75 @@ process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 	return tid;
 }
 
+/* Argument of __do_spawn(), on the stack of the parent, which waits in
+ * process_spawn() until the child is done with it. */
+struct spawn_aux {
+	struct thread *parent;
+	char *cmd_line;
+	bool success;
+};
+
+/* Starts a new process running CMD_LINE, a page that the function
+ * takes ownership of, as a child of the current process. Unlike
+ * fork() followed by exec(), the child never gets a copy of the
+ * parent's address space: it starts out empty and is loaded straight
+ * from the executable. File descriptors are still inherited. Returns
+ * the new process's thread id, or TID_ERROR if it cannot be created or
+ * loaded. */
+tid_t
+process_spawn (char *cmd_line) {
+	struct spawn_aux aux = { thread_current (), cmd_line, false };
+	char name[16], *save_ptr;
+	tid_t tid;
+
+	strlcpy (name, cmd_line, sizeof name);
+	strtok_r (name, " ", &save_ptr);
+
+	tid = thread_create (name, PRI_DEFAULT, __do_spawn, &aux);
+	if (tid == TID_ERROR) {
+		palloc_free_page (cmd_line);
+		return TID_ERROR;
+	}
+
+	struct thread *child = get_child_with_pid (tid);
+	sema_down (&child->fork_sema); // wait until child loads
+	if (!aux.success) {
+		/* Reap the child, which exits right away. */
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* A thread function that loads a spawned process. */
+static void
+__do_spawn (void *aux_) {
+	struct spawn_aux *aux = aux_;
+	struct thread *parent = aux->parent;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+	bool succ;
+
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+	current->rss_limit = parent->rss_limit;
+#endif
+	succ = duplicate_fds (parent);
+	if (succ)
+		succ = process_load (aux->cmd_line, &if_);
+	else
+		palloc_free_page (aux->cmd_line);
+
+	/* AUX is gone once the parent wakes up. */
+	aux->success = succ;
+	sema_up (&current->fork_sema);
+
+	if (succ)
+		do_iret (&if_);
+	current->exit_status = TID_ERROR;
+	exit (TID_ERROR);
+}
+
 #ifndef VM
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. */
@@ -156,51 +228,15 @@ struct MapElem
 };
 
 
-/* A thread function that copies parent's execution context.
- * Hint) parent->tf does not hold the userland context of the process.
- *       That is, you are required to pass second argument of process_fork to
- *       this function. */
-static void
-__do_fork (void *aux) {
-	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+/* Gives the current thread copies of PARENT's file descriptors, for
+ * fork() and spawn(). */
+static bool
+duplicate_fds (struct thread *parent) {
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
-
-	parent_if = &parent->parent_if;
-	bool succ = true;
-
-	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
-	if_.R.rax = 0; // 뭐얍 레지스터 값도 바꿔서 주나 // fork return for child
-
-	/* 2. Duplicate PT */
-	current->pml4 = pml4_create();
-	if (current->pml4 == NULL)
-		goto error;
-
-	// 약 530번째 줄, pml4_activate, tss_update
-	process_activate (current); 
-
-#ifdef VM
-	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
-		goto error;
-#else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
-		goto error;
-#endif
-
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
 
 	// multi-oom) Failed to duplicate?
 	if (parent->fdIdx == FDCOUNT_LIMIT)
-		goto error;
+		return false;
 
 	// Project2-extra) multiple fds sharing same file - use associative map (e.g. dict, hashmap) to duplicate these relationships
 	// other test-cases like multi-oom don't need this feature
@@ -243,6 +279,54 @@ __do_fork (void *aux) {
 		}
 	}
 	current->fdIdx = parent->fdIdx;
+	return true;
+}
+
+/* A thread function that copies parent's execution context.
+ * Hint) parent->tf does not hold the userland context of the process.
+ *       That is, you are required to pass second argument of process_fork to
+ *       this function. */
+static void
+__do_fork (void *aux) {
+	struct intr_frame if_;
+	struct thread *parent = (struct thread *) aux;
+	struct thread *current = thread_current ();
+	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
+	struct intr_frame *parent_if;
+
+	parent_if = &parent->parent_if;
+	bool succ = true;
+
+	/* 1. Read the cpu context to local stack. */
+	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0; // 뭐얍 레지스터 값도 바꿔서 주나 // fork return for child
+
+	/* 2. Duplicate PT */
+	current->pml4 = pml4_create();
+	if (current->pml4 == NULL)
+		goto error;
+
+	// 약 530번째 줄, pml4_activate, tss_update
+	process_activate (current); 
+
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+	/* Set before the copy, which already has to respect it. */
+	current->rss_limit = parent->rss_limit;
+	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+		goto error;
+#else
+	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
+		goto error;
+#endif
+
+	/* TODO: Your code goes here.
+	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
+	 * TODO:       in include/filesys/file.h. Note that parent should not return
+	 * TODO:       from the fork() until this function successfully duplicates
+	 * TODO:       the resources of parent.*/
+	if (!duplicate_fds (parent))
+		goto error;
 
 
 
@@ -264,24 +348,36 @@ error:
  * Returns -1 on fail. */
 int
 process_exec (void *f_name) {
-	char *file_name = f_name;
-	bool success;
-	struct thread *cur = thread_current(); // 이거 왜 필요하더라?
-
 	/* We cannot use the intr_frame in the thread structure.
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
 	struct intr_frame _if;
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;
-	_if.cs = SEL_UCSEG;
-	_if.eflags = FLAG_IF | FLAG_MBS;
+
+	if (!process_load (f_name, &_if))
+		return -1;
+
+	/* Start switched process. */
+	do_iret (&_if);
+	NOT_REACHED ();
+}
+
+/* Replaces the current context with the program and arguments in
+ * FILE_NAME, a page that is freed, and sets up _IF to start it.
+ * Shared by exec() and spawn(). */
+static bool
+process_load (char *file_name, struct intr_frame *_if) {
+	bool success;
+
+	_if->ds = _if->es = _if->ss = SEL_UDSEG;
+	_if->cs = SEL_UCSEG;
+	_if->eflags = FLAG_IF | FLAG_MBS;
 
 	/* We first kill the current context */
 	process_cleanup ();
 	supplemental_page_table_init (&thread_current()->spt);
 
 	// Project 2-1. Pass args - parse
-	char *argv[30];
+	char *argv[PROCESS_ARGS_MAX + 1];
 	int argc = 0;
 
 	char *token, *save_ptr;
@@ -295,32 +391,25 @@ process_exec (void *f_name) {
 	}
 
 	/* And then load the binary */
-	success = load (file_name, &_if);
+	success = load (file_name, _if);
 	
 	/* If load failed, quit. */
 	if (!success)
 	{
 		palloc_free_page(file_name);
-		return -1;
+		return false;
 	}
 
 	// Project 2-1. Pass args - load arguments onto the user stack
-	void **rspp = &_if.rsp;
+	void **rspp = &_if->rsp;
 	load_userStack(argv, argc, rspp);
-	_if.R.rdi = argc;
-	_if.R.rsi = (uint64_t)*rspp + sizeof(void *);
-
-	// hex_dump(_if.rsp, _if.rsp, USER_STACK - (uint64_t)*rspp, true);
+	_if->R.rdi = argc;
+	_if->R.rsi = (uint64_t)*rspp + sizeof(void *);
 
-	/* Initializing the set of vm_entries, e.g. hash table */
-	/* Initialize interrupt frame and load executable */
+	// hex_dump(_if->rsp, _if->rsp, USER_STACK - (uint64_t)*rspp, true);
 
-	/* If load failed, quit. */
 	palloc_free_page (file_name);
-
-	/* Start switched process. */
-	do_iret (&_if);
-	NOT_REACHED ();
+	return true;
 }
 
 // Load user stack with arguments
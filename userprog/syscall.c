@@ -11,7 +11,9 @@
 // add
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include <limits.h>
 #include <list.h>
+#include <string.h>
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
@@ -44,6 +46,7 @@ int dup2(int oldfd, int newfd);
 
 tid_t fork (const char *thread_name, struct intr_frame *f);
 int exec (char *file_name);
+tid_t spawn_s (const char *file, char **argv);
 
 // Project 2-4 File Descriptor
 static struct file *find_file_by_fd(int fd);
@@ -59,6 +62,25 @@ const int STDOUT = 2;
 static void check_writable_addr(void* ptr);
 
 void *mmap_s (void *addr, size_t length, int writable, int fd, off_t offset);
+int madvise_s (void *addr, size_t length, int advice);
+int msync_s (void *addr, size_t length, int flags);
+int memstat_s (struct vm_stat *st);
+int rsslimit_s (size_t pages);
+
+/* One buffer of readv() or writev(), as in lib/user/syscall.h. */
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#define IOV_MAX 1024
+
+int pread_s (int fd, void *buffer, unsigned size, off_t offset);
+int pwrite_s (int fd, const void *buffer, unsigned size, off_t offset);
+int readv_s (int fd, const struct iovec *iov, int iovcnt);
+int writev_s (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range_s (int in_fd, off_t *in_off, int out_fd, off_t *out_off,
+		size_t length);
+int sendfile_s (int out_fd, int in_fd, off_t *offset, size_t count);
 
 
 // temp
@@ -89,7 +111,6 @@ syscall_init (void) {
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 
 	// Project 2-4. File descriptor
-	lock_init(&file_rw_lock);
 	lock_init(&syscall_lock);
 }
 
@@ -113,6 +134,7 @@ syscall_handler (struct intr_frame *f UNUSED) {
 
 	struct thread* curr = thread_current ();
 	curr->stack_bottom = f->rsp;
+	vm_periodic_writeback ();
 
 
 	switch (f->R.rax)
@@ -130,6 +152,9 @@ syscall_handler (struct intr_frame *f UNUSED) {
 		if (exec(f->R.rdi) == -1)
 			exit(-1);
 		break;
+	case SYS_SPAWN:
+		f->R.rax = spawn_s(f->R.rdi, f->R.rsi);
+		break;
 	case SYS_WAIT:
 		f->R.rax = process_wait(f->R.rdi);
 		break;
@@ -171,6 +196,37 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	case SYS_MUNMAP:
 		munmap(f->R.rdi);
 		break;
+	case SYS_MADVISE:
+		f->R.rax = madvise_s(f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_MSYNC:
+		f->R.rax = msync_s(f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_MEMSTAT:
+		f->R.rax = memstat_s(f->R.rdi);
+		break;
+	case SYS_RSSLIMIT:
+		f->R.rax = rsslimit_s(f->R.rdi);
+		break;
+	case SYS_PREAD:
+		f->R.rax = pread_s(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+		break;
+	case SYS_PWRITE:
+		f->R.rax = pwrite_s(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+		break;
+	case SYS_READV:
+		f->R.rax = readv_s(f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_WRITEV:
+		f->R.rax = writev_s(f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_COPY_FILE_RANGE:
+		f->R.rax = copy_file_range_s(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10,
+				f->R.r8);
+		break;
+	case SYS_SENDFILE:
+		f->R.rax = sendfile_s(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10);
+		break;
 	default:
 		exit(-1);
 		break;
@@ -204,7 +260,7 @@ void check_address(const uint64_t *uaddr)
 	{
 		exit(-1);
 	}
-	struct page *page = spt_find_page (&thread_current() -> spt, uaddr);
+	struct page *page = spt_populate_page (&thread_current() -> spt, uaddr);
 	if (page == NULL) exit(-1);
 }
 
@@ -279,10 +335,7 @@ bool create(const char *file, unsigned initial_size)
 	/* 파일 생성 성공 시 true 반환, 실패 시 false 반환 */
 
 	check_address(file);
-	lock_acquire(&file_rw_lock);
-	bool result = filesys_create(file, initial_size);
-	lock_release(&file_rw_lock);
-	return result;
+	return filesys_create(file, initial_size);
 }
 
 bool remove(const char *file)
@@ -290,10 +343,7 @@ bool remove(const char *file)
 	/* 파일 이름에 해당하는 파일을 제거 */
 	/* 파일 제거 성공 시 true 반환, 실패 시 false 반환 */
 	check_address(file);
-	lock_acquire(&file_rw_lock);
-	bool result = filesys_remove(file);
-	lock_release(&file_rw_lock);
-	return result;
+	return filesys_remove(file);
 }
 
 int open(const char *file)
@@ -307,10 +357,8 @@ int open(const char *file)
 	int fd = add_file_to_fdt(fileobj);
 
 	// FD table full
-	lock_acquire(&file_rw_lock);
 	if (fd == -1)
 		file_close(fileobj);
-	lock_release(&file_rw_lock);
 	return fd;
 }
 
@@ -365,9 +413,13 @@ int read(int fd, void *buffer, unsigned size)
 		ret = -1;
 	}
 	else{
-		lock_acquire(&file_rw_lock);
+		/* Evicting a page of the buffer mid-copy could need the file
+		 * system, so fault it all in and pin it before the inode is
+		 * locked. */
+		if (!vm_pin_buffer(buffer, size, true))
+			exit(-1);
 		ret = file_read(fileobj, buffer, size);
-		lock_release(&file_rw_lock);
+		vm_unpin_buffer(buffer, size);
 	}
 	return ret;
 }
@@ -406,9 +458,10 @@ int write(int fd, const void *buffer, unsigned size)
 	}
 	else
 	{
-		lock_acquire(&file_rw_lock);
+		if (!vm_pin_buffer(buffer, size, false))
+			exit(-1);
 		ret = file_write(fileobj, buffer, size);
-		lock_release(&file_rw_lock);
+		vm_unpin_buffer(buffer, size);
 	}
 
 	return ret;
@@ -523,6 +576,71 @@ int exec (char *file_name)
 	return 0;
 }
 
+/* Returns the number of words separated by spaces in S, as
+ * process_load() will split them. */
+static int
+count_words (const char *s)
+{
+	int cnt = 0;
+	bool in_word = false;
+
+	for (; *s != '\0'; s++) {
+		if (*s == ' ')
+			in_word = false;
+		else if (!in_word) {
+			in_word = true;
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+/* Starts FILE as a new child process without copying the caller's
+ * address space. ARGV is null-terminated, and its first element is
+ * replaced by FILE, as exec() names the process after the file. The
+ * arguments are joined into a command line like exec() takes, so
+ * they cannot contain spaces. At most PROCESS_ARGS_MAX words
+ * are taken. */
+tid_t spawn_s (const char *file, char **argv)
+{
+	int word_cnt;
+
+	/* Check the whole vector before taking the page, since a bad
+	 * pointer exits right away. */
+	check_address((const uint64_t *) file);
+	word_cnt = count_words(file);
+	if (argv != NULL) {
+		check_address((const uint64_t *) argv);
+		for (int i = 1; ; i++) {
+			check_address((const uint64_t *) &argv[i]);
+			if (argv[i] == NULL)
+				break;
+			check_address((const uint64_t *) argv[i]);
+			word_cnt += count_words(argv[i]);
+			if (word_cnt > PROCESS_ARGS_MAX)
+				return TID_ERROR;
+		}
+	}
+	if (word_cnt > PROCESS_ARGS_MAX)
+		return TID_ERROR;
+
+	char *cmd_line = palloc_get_page(0);
+	if (cmd_line == NULL)
+		return TID_ERROR;
+	strlcpy(cmd_line, file, PGSIZE);
+
+	if (argv != NULL) {
+		for (int i = 1; argv[i] != NULL; i++) {
+			strlcat(cmd_line, " ", PGSIZE);
+			if (strlcat(cmd_line, argv[i], PGSIZE) >= PGSIZE) {
+				palloc_free_page(cmd_line);
+				return TID_ERROR;
+			}
+		}
+	}
+	return process_spawn(cmd_line);
+}
+
 // temp
 int _write (int fd UNUSED, const void *buffer, unsigned size) {
 	// temporary code to pass args related test case
@@ -575,7 +693,7 @@ void remove_file_from_fdt(int fd)
 
 static void
 check_writable_addr(void* ptr){
-	struct page *page = spt_find_page (&thread_current() -> spt, ptr);
+	struct page *page = spt_populate_page (&thread_current() -> spt, ptr);
 	if (page == NULL || !page->writable) exit(-1);
 }
 
@@ -605,19 +723,262 @@ void *mmap_s (void *addr, size_t length, int writable, int fd, off_t offset){
 	You can use vm_alloc_page_with_initializer or vm_alloc_page to make a page object.
 	*/
 
+	bool shared = (writable & MAP_SHARED) != 0;
+	writable &= ~MAP_SHARED;
+
 	if (addr == 0 || (!is_user_vaddr(addr))) return NULL;
 	if ((uint64_t)addr % PGSIZE != 0) return NULL;
 	if (offset % PGSIZE != 0) return NULL;
 	if ((uint64_t)addr + length == 0) return NULL;
 	if (!is_user_vaddr((uint64_t)addr + length)) return NULL;
-	for (uint64_t i = (uint64_t) addr; i < (uint64_t) addr + length; i += PGSIZE){
-		if (spt_find_page (&thread_current() -> spt, (void*) i)!=NULL) return NULL;
-	}
+	if (!spt_range_is_free (&thread_current ()->spt, addr, addr + length))
+		return NULL;
 
 	if (length == 0) return NULL;
+	if (shared && fd == -1)
+		return do_mmap_shared(addr, length, writable, NULL, offset);
 	struct file* file = find_file_by_fd(fd);
 	if(file == NULL) return NULL;
 
+	if (shared)
+		return do_mmap_shared(addr, length, writable, file, offset);
 	return do_mmap(addr, length, writable, file, offset);
 }
 
+/* Passes a paging hint for [ADDR, ADDR + LENGTH) on to the VM.
+ * Returns 0 on success, -1 for a bad range or unknown advice. */
+int madvise_s (void *addr, size_t length, int advice){
+	if (pg_ofs(addr) != 0 || !is_user_vaddr(addr)) return -1;
+	if ((uint64_t)addr + length < (uint64_t)addr) return -1;
+	if (!is_user_vaddr((uint64_t)addr + length)) return -1;
+
+	return vm_madvise(addr, length, advice) ? 0 : -1;
+}
+
+/* Writes the dirty pages of the mappings in [ADDR, ADDR + LENGTH) back
+ * to their files. Returns 0 on success, -1 for bad arguments or if part
+ * of the range is not mapped. */
+int msync_s (void *addr, size_t length, int flags){
+	if (pg_ofs(addr) != 0 || !is_user_vaddr(addr)) return -1;
+	if ((uint64_t)addr + length < (uint64_t)addr) return -1;
+	if (!is_user_vaddr((uint64_t)addr + length)) return -1;
+	if ((flags & ~(MS_ASYNC | MS_INVALIDATE | MS_SYNC)) != 0) return -1;
+	if ((flags & MS_ASYNC) && (flags & MS_SYNC)) return -1;
+
+	return vm_msync(addr, length) ? 0 : -1;
+}
+
+/* Copies the memory usage of the process to ST. Returns 0; like any
+ * bad pointer, an ST that is not writable user memory kills the
+ * process. */
+int memstat_s (struct vm_stat *st){
+	struct vm_stat kst;
+
+	check_address((const uint64_t *) st);
+	check_address((const uint64_t *) ((uint8_t *) st + sizeof *st - 1));
+	if (!vm_pin_buffer(st, sizeof *st, true)) exit(-1);
+	vm_get_stat(&kst);
+	*st = kst;
+	vm_unpin_buffer(st, sizeof *st);
+	return 0;
+}
+
+/* Limits the process to PAGES resident pages, 0 meaning no limit. The
+ * limit is inherited by forked children. Always returns 0. */
+int rsslimit_s (size_t pages){
+	vm_set_rss_limit(pages);
+	return 0;
+}
+
+/* Reads SIZE bytes at OFFSET of the file open as FD into BUFFER. The
+ * file position is neither used nor moved, so processes sharing the
+ * file can read it at once. Returns the bytes read, or -1 if FD is not
+ * an open file or OFFSET is negative. */
+int pread_s (int fd, void *buffer, unsigned size, off_t offset){
+	struct file *fileobj = find_file_by_fd(fd);
+	int ret;
+
+	if (fileobj == NULL || fileobj == STDIN || fileobj == STDOUT)
+		return -1;
+	if (offset < 0) return -1;
+	if (size == 0) return 0;
+
+	check_address(buffer);
+	if (!vm_pin_buffer(buffer, size, true))
+		exit(-1);
+	ret = file_read_at(fileobj, buffer, size, offset);
+	vm_unpin_buffer(buffer, size);
+	return ret;
+}
+
+/* Writes SIZE bytes from BUFFER at OFFSET of the file open as FD,
+ * leaving the file position alone. Returns the bytes written, or -1
+ * like pread_s(). */
+int pwrite_s (int fd, const void *buffer, unsigned size, off_t offset){
+	struct file *fileobj = find_file_by_fd(fd);
+	int ret;
+
+	if (fileobj == NULL || fileobj == STDIN || fileobj == STDOUT)
+		return -1;
+	if (offset < 0) return -1;
+	if (size == 0) return 0;
+
+	check_address(buffer);
+	if (!vm_pin_buffer(buffer, size, false))
+		exit(-1);
+	ret = file_write_at(fileobj, buffer, size, offset);
+	vm_unpin_buffer(buffer, size);
+	return ret;
+}
+
+/* Does read() or write() on FD for each of the IOVCNT buffers of IOV
+ * in turn, in one system call. Stops at the first short transfer.
+ * Returns the total bytes moved, or -1 if nothing could be. */
+static int
+rw_vector (int fd, const struct iovec *iov, int iovcnt, bool is_read){
+	size_t size;
+	int total = 0;
+	int i;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX) return -1;
+	if (iovcnt == 0) return 0;
+	size = iovcnt * sizeof *iov;
+
+	check_address((const uint64_t *) iov);
+	check_address((const uint64_t *) ((uint8_t *) iov + size - 1));
+	if (!vm_pin_buffer(iov, size, false))
+		exit(-1);
+	for (i = 0; i < iovcnt; i++) {
+		struct iovec v = iov[i];
+		int ret;
+
+		if (v.iov_len == 0)
+			continue;
+		if (v.iov_len > INT_MAX - (size_t) total)
+			v.iov_len = INT_MAX - total;
+		ret = is_read ? read(fd, v.iov_base, v.iov_len)
+				: write(fd, v.iov_base, v.iov_len);
+		if (ret < 0) {
+			if (total == 0)
+				total = -1;
+			break;
+		}
+		total += ret;
+		if ((size_t) ret < v.iov_len)
+			break;
+	}
+	vm_unpin_buffer(iov, size);
+	return total;
+}
+
+/* Reads from FD into the IOVCNT buffers of IOV, filling each before
+ * the next. */
+int readv_s (int fd, const struct iovec *iov, int iovcnt){
+	return rw_vector(fd, iov, iovcnt, true);
+}
+
+/* Writes the IOVCNT buffers of IOV to FD, one after the other. */
+int writev_s (int fd, const struct iovec *iov, int iovcnt){
+	return rw_vector(fd, iov, iovcnt, false);
+}
+
+/* Returns the offset to copy from or to in FILE: *OFFP, or the file
+ * position if OFFP is NULL. A bad OFFP kills the process. */
+static off_t
+offset_get (struct file *file, off_t *offp){
+	off_t ofs;
+
+	if (offp == NULL)
+		return file_tell(file);
+	check_address((const uint64_t *) offp);
+	if (!vm_pin_buffer(offp, sizeof *offp, true))
+		exit(-1);
+	ofs = *offp;
+	vm_unpin_buffer(offp, sizeof *offp);
+	return ofs;
+}
+
+/* Stores OFS, the offset after a copy, where offset_get() took it
+ * from. */
+static void
+offset_put (struct file *file, off_t *offp, off_t ofs){
+	if (offp == NULL) {
+		file_seek(file, ofs);
+		return;
+	}
+	if (!vm_pin_buffer(offp, sizeof *offp, true))
+		exit(-1);
+	*offp = ofs;
+	vm_unpin_buffer(offp, sizeof *offp);
+}
+
+/* Copies LENGTH bytes from the file open as IN_FD to the one open as
+ * OUT_FD without passing them through user memory. Each of IN_OFF and
+ * OUT_OFF points to the offset to use, which is advanced past the
+ * copied bytes; if it is NULL, the file position is used and advanced
+ * instead. Returns the bytes copied, 0 at the end of the input, or -1
+ * if either fd is not an open file, an offset is negative, or the two
+ * ranges overlap within one file. */
+int copy_file_range_s (int in_fd, off_t *in_off, int out_fd, off_t *out_off,
+		size_t length){
+	struct file *in = find_file_by_fd(in_fd);
+	struct file *out = find_file_by_fd(out_fd);
+	off_t in_ofs, out_ofs, ret;
+
+	if (in == NULL || in == STDIN || in == STDOUT)
+		return -1;
+	if (out == NULL || out == STDIN || out == STDOUT)
+		return -1;
+	in_ofs = offset_get(in, in_off);
+	out_ofs = offset_get(out, out_off);
+	if (in_ofs < 0 || out_ofs < 0)
+		return -1;
+	if (length > (size_t) (INT_MAX - (in_ofs > out_ofs ? in_ofs : out_ofs)))
+		length = INT_MAX - (in_ofs > out_ofs ? in_ofs : out_ofs);
+	if (file_get_inode(in) == file_get_inode(out)
+			&& in_ofs < out_ofs + (off_t) length
+			&& out_ofs < in_ofs + (off_t) length)
+		return -1;
+
+	ret = file_copy_range(out, out_ofs, in, in_ofs, length);
+	offset_put(in, in_off, in_ofs + ret);
+	offset_put(out, out_off, out_ofs + ret);
+	return ret;
+}
+
+/* Copies COUNT bytes from the file open as IN_FD to OUT_FD, which may
+ * also be the console, without passing them through user memory.
+ * OFFSET works like the offsets of copy_file_range_s(), and OUT_FD's
+ * position is advanced. Returns the bytes copied, or -1. */
+int sendfile_s (int out_fd, int in_fd, off_t *offset, size_t count){
+	struct file *in = find_file_by_fd(in_fd);
+	struct file *out = find_file_by_fd(out_fd);
+	off_t ofs, ret = 0;
+
+	if (out != STDOUT)
+		return copy_file_range_s(in_fd, offset, out_fd, NULL, count);
+	if (in == NULL || in == STDIN || in == STDOUT)
+		return -1;
+	ofs = offset_get(in, offset);
+	if (ofs < 0)
+		return -1;
+	if (count > (size_t) (INT_MAX - ofs))
+		count = INT_MAX - ofs;
+
+	char *buffer = palloc_get_page(0);
+	if (buffer == NULL)
+		return -1;
+	while (count > 0) {
+		off_t chunk = count < PGSIZE ? count : PGSIZE;
+		off_t read = file_read_at(in, buffer, chunk, ofs + ret);
+
+		putbuf(buffer, read);
+		ret += read;
+		count -= read;
+		if (read < chunk)
+			break;
+	}
+	palloc_free_page(buffer);
+	offset_put(in, offset, ofs + ret);
+	return ret;
+}
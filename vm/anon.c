@@ -1,7 +1,9 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <string.h>
 #include "devices/disk.h"
+#include "threads/mmu.h"
 
 #include <bitmap.h>
 
@@ -23,6 +25,8 @@ static const struct page_operations anon_ops = {
 };
 
 static struct bitmap *swap_table;
+/* Protects swap_table: several threads may evict at once. */
+static struct lock swap_lock;
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
@@ -34,6 +38,51 @@ vm_anon_init (void) {
 	size_t max_slot = num_sector / SECTORS_PER_PAGE;
 
 	swap_table = bitmap_create(max_slot);
+	lock_init (&swap_lock);
+}
+
+/* Writes the page at KVA to a free swap slot and returns the slot. */
+size_t
+swap_write_page (const void *kva) {
+	// Get swap slot index from swap table
+	lock_acquire (&swap_lock);
+	size_t swap_slot_idx = bitmap_scan_and_flip(swap_table, 0, 1, false);
+	lock_release (&swap_lock);
+	if (swap_slot_idx == BITMAP_ERROR)
+		PANIC("There is no free swap slot!!");
+
+	// Write page to disk with sector size chunk
+	for (int i = 0; i < SECTORS_PER_PAGE; i++) {
+		// convert swap slot index to writing sector number
+		disk_sector_t sec_no = (disk_sector_t) (swap_slot_idx * SECTORS_PER_PAGE) + i;
+		disk_write (swap_disk, sec_no, kva + i * DISK_SECTOR_SIZE);
+	}
+	return swap_slot_idx;
+}
+
+/* Reads swap slot SWAP_SLOT_IDX into KVA, keeping the slot. */
+void
+swap_copy_page (size_t swap_slot_idx, void *kva) {
+	// Read page from disk with sector size chunk
+	for (int i = 0; i < SECTORS_PER_PAGE; i++) {
+		disk_sector_t sec_no = (disk_sector_t) (swap_slot_idx * SECTORS_PER_PAGE) + i;
+		disk_read (swap_disk, sec_no, kva + i * DISK_SECTOR_SIZE);
+	}
+}
+
+/* Reads swap slot SWAP_SLOT_IDX into KVA and frees the slot. */
+void
+swap_read_page (size_t swap_slot_idx, void *kva) {
+	swap_copy_page (swap_slot_idx, kva);
+	swap_free_slot (swap_slot_idx);
+}
+
+/* Releases swap slot SWAP_SLOT_IDX without reading it. */
+void
+swap_free_slot (size_t swap_slot_idx) {
+	lock_acquire (&swap_lock);
+	bitmap_set (swap_table, swap_slot_idx, false);
+	lock_release (&swap_lock);
 }
 
 /* Initialize the file mapping */
@@ -46,6 +95,8 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	struct anon_page *anon_page = &page->anon;
 	anon_page->owner = thread_current();
 	anon_page->swap_slot_idx = INVALID_SLOT_IDX;
+	anon_page->ksm = NULL;
+	anon_page->file_backed = false;
 	return true;
 }
 
@@ -53,16 +104,13 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
-	if (anon_page->swap_slot_idx == INVALID_SLOT_IDX) return false;
-
-	disk_sector_t sec_no;
-	// Read page from disk with sector size chunk
-	for (int i = 0; i < SECTORS_PER_PAGE; i++){
-		sec_no = (disk_sector_t) (anon_page->swap_slot_idx * SECTORS_PER_PAGE) + i;
-		off_t ofs = i * DISK_SECTOR_SIZE;
-		disk_read(swap_disk, sec_no, kva+ofs);
+	if (anon_page->swap_slot_idx == INVALID_SLOT_IDX) {
+		/* Contents were discarded by anon_discard(). */
+		memset (kva, 0, PGSIZE);
+		return true;
 	}
-	bitmap_set (swap_table, anon_page->swap_slot_idx, false);
+
+	swap_read_page (anon_page->swap_slot_idx, kva);
 	anon_page->swap_slot_idx = INVALID_SLOT_IDX;
 	return true;
 }
@@ -72,49 +120,61 @@ static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
 
-	// Get swap slot index from swap table
-	size_t swap_slot_idx = bitmap_scan_and_flip(swap_table, 0, 1, false);
-	if (swap_slot_idx == BITMAP_ERROR)
-		PANIC("There is no free swap slot!!");
-
 	if (page == NULL || page->frame == NULL || page->frame->kva == NULL)
 		return false;
 
-	// Copy page frame content to swap_slot
-	disk_sector_t sec_no;
-	// Write page to disk with sector size chunk
-	for (int i = 0; i < SECTORS_PER_PAGE; i++) {
-		// convert swap slot index to writing sector number
-		sec_no = (disk_sector_t) (swap_slot_idx * SECTORS_PER_PAGE) + i;
-		off_t ofs = i * DISK_SECTOR_SIZE;
-		disk_write (swap_disk, sec_no, page->frame->kva + ofs);
-	}
-	anon_page->swap_slot_idx = swap_slot_idx;
-
-	// Set "not present" to page, and clear
+	// Set "not present" to page first, so that the owner cannot change
+	// it behind our back while it is written out
 	pml4_clear_page(anon_page->owner->pml4, page->va);
 	pml4_set_dirty(anon_page->owner->pml4, page->va, false);
+
+	// Copy page frame content to swap_slot
+	anon_page->swap_slot_idx = swap_write_page (page->frame->kva);
 	page->frame = NULL;
 
 	return true;
-	// Copy page frame content to swap_slot
-	
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	// struct anon_page *anon_page = &page->anon;
-	if (page -> frame!= NULL){
-		list_remove (&page->frame->elem);
-		free(page->frame); // 얘
+	struct frame *frame = vm_frame_detach (&page->frame);
+	if (frame != NULL){
+		vm_free_frame (frame);
+	}
+	else if (page->anon.ksm != NULL) {
+		// Merged page: the frame is not ours, keep pml4_destroy off it
+		pml4_clear_page (page->anon.owner->pml4, page->va);
+		ksm_leave (page);
 	}
 	else {
-		// Swapped anon page case
+		// Swapped anon page case; a discarded page has no slot
 		struct anon_page *anon_page = &page->anon;
-		ASSERT (anon_page->swap_slot_idx != INVALID_SLOT_IDX);
 
 		// Clear swap table
-		bitmap_set (swap_table, anon_page->swap_slot_idx, false);
+		if (anon_page->swap_slot_idx != INVALID_SLOT_IDX)
+			swap_free_slot (anon_page->swap_slot_idx);
+	}
+}
+
+/* Throws away the contents of the anonymous PAGE, freeing its frame or
+ * swap slot. The page stays in the spt and reads back as zeros. */
+void
+anon_discard (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+	struct frame *frame = vm_frame_detach (&page->frame);
+
+	if (frame != NULL) {
+		pml4_clear_page (anon_page->owner->pml4, page->va);
+		palloc_free_page (frame->kva);
+		vm_free_frame (frame);
+		page->frame = NULL;
+	} else if (anon_page->ksm != NULL) {
+		pml4_clear_page (anon_page->owner->pml4, page->va);
+		ksm_leave (page);
+	} else if (anon_page->swap_slot_idx != INVALID_SLOT_IDX) {
+		swap_free_slot (anon_page->swap_slot_idx);
+		anon_page->swap_slot_idx = INVALID_SLOT_IDX;
 	}
 }
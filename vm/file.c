@@ -1,6 +1,10 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <stdlib.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
 #include "userprog/process.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -16,19 +20,10 @@ static const struct page_operations file_ops = {
 };
 
 
-static struct list mmap_file_list;
-
 /* The initializer of file vm */
 void
 vm_file_init (void) {
-	list_init(&mmap_file_list);
-};
-
-struct mmap_file_info{
-	struct list_elem elem;
-	uint64_t start;
-	uint64_t end;
-};
+}
 
 /* Initialize the file backed page */
 bool
@@ -48,8 +43,8 @@ file_backed_swap_in (struct page *page, void *kva) {
 	struct file_page *file_page = &page->file;
 	if (file_page->file == NULL) return false;
 
-	file_seek (file_page->file, file_page->ofs);
-	off_t read_size = file_read (file_page->file, kva, file_page->size);
+	off_t read_size = file_read_at (file_page->file, kva, file_page->size,
+			file_page->ofs);
 	if (read_size != file_page->size) return false;
 	if (read_size < PGSIZE)
 		memset (kva + read_size, 0, PGSIZE - read_size);
@@ -57,20 +52,22 @@ file_backed_swap_in (struct page *page, void *kva) {
 	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file. The evicting
+ * thread need not be the owner, so go through the owner's pml4 and the
+ * frame's kva. */
 static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page = &page->file;
-	struct thread *curr = thread_current ();
+	uint64_t *pml4 = page->frame->owner->pml4;
 
-	if (pml4_is_dirty (curr->pml4, page->va)) {
-		file_seek (file_page->file, file_page->ofs);
-		file_write (file_page->file, page->va, file_page->size);
-		pml4_set_dirty (curr->pml4, page->va, false);
+	// Set "not present" to page first, so that the owner cannot dirty it
+	// again while it is written back.
+	pml4_clear_page (pml4, page->va);
+	if (pml4_is_dirty (pml4, page->va)) {
+		pml4_set_dirty (pml4, page->va, false);
+		file_write_at (file_page->file, page->frame->kva, file_page->size,
+				file_page->ofs);
 	}
-
-	// Set "not present" to page, and clear.
-	pml4_clear_page (curr->pml4, page->va);
 	page->frame = NULL;
 
 	return true;
@@ -81,23 +78,27 @@ static void
 file_backed_destroy (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
 	struct thread *curr = thread_current ();
+	struct frame *frame = vm_frame_detach (&page->frame);
 
-	if (pml4_is_dirty (thread_current() -> pml4, page-> va)){
-		file_seek(file_page->file, file_page->ofs);
-		file_write(file_page->file, page->va, file_page->size);
-		pml4_set_dirty(curr->pml4, page->va, false);
-	}
+	if (frame == NULL)
+		return;
 
-	pml4_clear_page(curr->pml4, page->va);
-	page->frame = NULL;
+	if (pml4_is_dirty (curr->pml4, page->va))
+		file_write_at (file_page->file, frame->kva, file_page->size,
+				file_page->ofs);
 
-	return true;
+	/* The pte goes away with the page, so pml4_destroy will not free the
+	 * frame for us. */
+	pml4_clear_page (curr->pml4, page->va);
+	palloc_free_page (frame->kva);
+	vm_free_frame (frame);
+	page->frame = NULL;
 }
 
 static bool lazy_load_file(struct page *page, void* aux){
 	struct mmap_info* mi = (struct mmap_info*) aux;
-	file_seek (mi->file, mi->ofs);
-	page -> file.size = file_read(mi->file, page->va, mi->page_read_bytes);
+	page -> file.size = file_read_at (mi->file, page->va, mi->page_read_bytes,
+			mi->ofs);
 	page -> file.ofs = mi->ofs;
 	if (page->file.size != PGSIZE){
 		memset (page->va + page ->file.size, 0, PGSIZE - page->file.size);
@@ -107,91 +108,216 @@ static bool lazy_load_file(struct page *page, void* aux){
 	return true;
 }
 
-/* Do the mmap */
+/* Creates the page for VA inside VMA on its first fault. The page shares
+ * the area's file; nothing is allocated for pages that are never touched. */
+struct page *
+mmap_populate_page (struct vm_area *vma, void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t page_ofs = va - vma->start;
+
+	ASSERT (pg_ofs (va) == 0);
+	ASSERT (vma->start <= va && va < vma->end);
+
+	if (vma->obj != NULL)
+		return shm_populate_page (vma, va);
+
+	struct mmap_info *mi = malloc (sizeof (struct mmap_info));
+	if (mi == NULL)
+		return NULL;
+	mi->file = vma->file;
+	mi->ofs = vma->offset + page_ofs;
+	mi->page_read_bytes = vma->length - page_ofs >= PGSIZE ?
+		PGSIZE : vma->length - page_ofs;
+
+	if (!vm_alloc_page_with_initializer (VM_FILE, va, vma->writable,
+				lazy_load_file, mi)) {
+		free (mi);
+		return NULL;
+	}
+	struct page *page = spt_find_page (spt, va);
+	page->vma = vma;
+	list_push_back (&vma->pages, &page->vma_elem);
+	return page;
+}
+
+/* Do the mmap.
+ * Only the region is recorded here; pages are created by
+ * mmap_populate_page() when they are first touched. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
-	off_t ofs;
-	uint64_t read_bytes;
-	for (uint64_t i = 0; i < length; i += PGSIZE){
-		struct mmap_info * mi = malloc(sizeof(struct mmap_info));
-		ofs = offset + i;
-		read_bytes = length - i >= PGSIZE ? PGSIZE : length -i;
-		mi->file = file_reopen(file);
-		mi->ofs = ofs;
-		mi->page_read_bytes = read_bytes;
-		vm_alloc_page_with_initializer(VM_FILE, (void *) ((uint64_t) addr + i), writable, lazy_load_file, (void *)mi);
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+
+	struct file *mfile = file_reopen (file);
+	if (mfile == NULL)
+		return NULL;
+	if (vma_insert (&spt->vmas, addr, length, mfile, offset, writable) == NULL) {
+		file_close (mfile);
+		return NULL;
+	}
+	return addr;
+}
+
+/* Do a MAP_SHARED mmap of FILE, or of anonymous memory if FILE is NULL.
+ * All shared mappings of a file map the same frames. */
+void *
+do_mmap_shared (void *addr, size_t length, int writable,
+		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct shm_object *obj;
+	struct vm_area *vma;
+
+	obj = file != NULL ? shm_object_open (file) : shm_object_create ();
+	if (obj == NULL)
+		return NULL;
+	vma = vma_insert (&spt->vmas, addr, length, NULL, offset, writable);
+	if (vma == NULL) {
+		shm_object_close (obj);
+		return NULL;
 	}
-	struct mmap_file_info* mfi = malloc(sizeof (struct mmap_file_info));
-	mfi->start = (uint64_t) addr;
-	mfi->end = (uint64_t) pg_round_down((uint64_t) addr + length -1);
-	list_push_back(&mmap_file_list, &mfi->elem);
-	
+	vma->obj = obj;
 	return addr;
-	/* 
-	A call to mmap may fail if the file opened as fd has a length of zero bytes. 
-	파일의 	byte 수가 0은 아닌지
-	It must fail if addr is not page-aligned 
-	or if the range of pages mapped overlaps any existing set of mapped pages, 
-	including the stack or pages mapped at executable load time. 
-
-	In Linux, if addr is NULL, the kernel finds an appropriate address at which to create the mapping. 
-	For simplicity, you can just attempt to mmap at the given addr. 
-
-	Therefore, if addr is 0, it must fail, because some Pintos code assumes virtual page 0 is not mapped. 
-	Your mmap should also fail when length is zero. 
-
-	Finally, the file descriptors representing console input and output are not mappable.
-	Memory-mapped pages should be also allocated in a lazy manner just like anonymous pages. 
-	You can use vm_alloc_page_with_initializer or vm_alloc_page to make a page object.
-	*/
-
-	// void *ori_addr = addr;
-	// size_t read_bytes = length > file_length(file) ? file_length(file) : length;
-	// // size_t zero_bytes = PGSIZE - read_bytes % PGSIZE; //마지막 페이지 잔여 공간인듯
-	// size_t zero_bytes = PGSIZE - read_bytes % PGSIZE; //마지막 페이지 잔여 공간인듯
-
-	// while (read_bytes > 0 || zero_bytes > 0) // zoro_bytes는 맨 마지막 페이지에만 생길텐데 빼줘도 되는거아닌가
-	// {
-	// 	size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-	// 	size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-	// 	struct mmap_info *mmap_info = malloc(sizeof (struct mmap_info));
-	// 	struct file *mfile = file_reopen(file);
-	// 	mmap_info->file = mfile;
-	// 	mmap_info->ofs = offset;
-	// 	mmap_info->page_read_bytes = page_read_bytes;
-	// 	// mmap_info->page_zero_bytes = page_zero_bytes;
-
-	// 	if(!vm_alloc_page_with_initializer(VM_FILE, addr, writable, lazy_load_segment, mmap_info))
-	// 	{
-	// 		printf("\n\n err at file.c \n\n");
-	// 		return NULL;
-	// 	}
-
-	// 	read_bytes -= page_read_bytes;
-	// 	zero_bytes -= page_zero_bytes;
-	// 	addr += PGSIZE;
-	// 	offset += page_read_bytes;	// 그냥 PGSIZE 해줘도 무관할거같기도
-	// }
-	// return ori_addr;
+}
+
+/* Largest run of adjacent dirty pages that is written back at once. */
+#define WRITEBACK_BATCH 16
+
+/* A dirty page of a private mapping waiting for writeback. */
+struct wb_page {
+	struct frame *frame;        /* Pinned until written. */
+	void *kva;
+	off_t ofs;
+	off_t size;
+};
+
+static int
+wb_page_cmp (const void *a_, const void *b_) {
+	const struct wb_page *a = a_;
+	const struct wb_page *b = b_;
+	return a->ofs < b->ofs ? -1 : a->ofs > b->ofs;
+}
+
+/* Writes the CNT pages of WB, sorted by offset, to FILE. Runs of pages
+ * that are adjacent in the file are copied into BUF, which holds
+ * WRITEBACK_BATCH pages, and written with one call. BUF may be NULL. */
+static void
+writeback_pages (struct file *file, struct wb_page *wb, size_t cnt,
+		uint8_t *buf) {
+	size_t i = 0;
+
+	while (i < cnt) {
+		size_t n = 1;
+		if (buf != NULL)
+			while (i + n < cnt && n < WRITEBACK_BATCH
+					&& wb[i + n - 1].size == PGSIZE
+					&& wb[i + n].ofs == wb[i + n - 1].ofs + PGSIZE)
+				n++;
+
+		if (n == 1)
+			file_write_at (file, wb[i].kva, wb[i].size, wb[i].ofs);
+		else {
+			off_t size = 0;
+			for (size_t j = i; j < i + n; j++) {
+				memcpy (buf + size, wb[j].kva, wb[j].size);
+				size += wb[j].size;
+			}
+			file_write_at (file, buf, size, wb[i].ofs);
+		}
+		i += n;
+	}
+}
+
+/* Writes the dirty pages of VMA that lie in [START, END) back to the
+ * file and marks them clean. The pages stay mapped. */
+void
+mmap_sync (struct vm_area *vma, void *start, void *end) {
+	struct thread *curr = thread_current ();
+	struct tlb_gather tlb;
+	struct wb_page *wb;
+	struct list_elem *e;
+	size_t cnt = 0;
+
+	if (vma->obj != NULL) {
+		for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, vma_elem);
+			if (start <= page->va && page->va < end)
+				shm_slot_sync (page->shared.slot);
+		}
+		return;
+	}
+	if (list_empty (&vma->pages))
+		return;
+
+	wb = malloc (list_size (&vma->pages) * sizeof *wb);
+	tlb_gather_begin (&tlb, curr->pml4);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+		struct frame *frame;
+		if (page->va < start || page->va >= end)
+			continue;
+		/* Keep the frame from being evicted until it is written. */
+		frame = vm_pin_page (page);
+		if (frame == NULL)
+			continue;
+		if (!pml4_is_dirty (curr->pml4, page->va)) {
+			vm_unpin_frame (frame);
+			continue;
+		}
+
+		/* Clean before copying: a later write dirties the page again. */
+		pml4_set_dirty (curr->pml4, page->va, false);
+		if (wb == NULL) {
+			file_write_at (vma->file, frame->kva, page->file.size,
+					page->file.ofs);
+			vm_unpin_frame (frame);
+		} else
+			wb[cnt++] = (struct wb_page) {
+				.frame = frame,
+				.kva = frame->kva,
+				.ofs = page->file.ofs,
+				.size = page->file.size,
+			};
+	}
+	/* The pages must be clean in the TLB too before any user write. */
+	tlb_gather_end (&tlb);
+	if (wb == NULL)
+		return;
+
+	if (cnt > 0) {
+		uint8_t *buf = cnt > 1 ? palloc_get_multiple (0, WRITEBACK_BATCH) : NULL;
+		qsort (wb, cnt, sizeof *wb, wb_page_cmp);
+		writeback_pages (vma->file, wb, cnt, buf);
+		if (buf != NULL)
+			palloc_free_multiple (buf, WRITEBACK_BATCH);
+		for (size_t i = 0; i < cnt; i++)
+			vm_unpin_frame (wb[i].frame);
+	}
+	free (wb);
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-	if (list_empty (&mmap_file_list)) return;
-	for (struct list_elem* i = list_front (&mmap_file_list); i != list_end (&mmap_file_list); i = list_next (i))
-	{
-		struct mmap_file_info* mfi = list_entry (i, struct mmap_file_info, elem);
-		if (mfi -> start == (uint64_t) addr){
-			for (uint64_t j = (uint64_t)addr; j<= mfi -> end; j += PGSIZE){
-				struct page* page = spt_find_page(&thread_current() -> spt, (void*) j);
-				spt_remove_page(&thread_current()->spt, page);
-			};
-			list_remove(&mfi->elem);
-			free(mfi);
-			return;
-		}
+	struct thread *curr = thread_current ();
+	struct supplemental_page_table *spt = &curr->spt;
+	struct vm_area *vma = vma_find (&spt->vmas, addr);
+	struct tlb_gather tlb;
+	if (vma == NULL || vma->start != addr)
+		return;
+
+	tlb_gather_begin (&tlb, curr->pml4);
+	/* Flush in batches first, so that destroying the pages below finds
+	 * them clean. */
+	mmap_sync (vma, vma->start, vma->end);
+
+	/* Only pages that were faulted in exist; write them back and drop them. */
+	while (!list_empty (&vma->pages)) {
+		struct page *page = list_entry (list_pop_front (&vma->pages),
+				struct page, vma_elem);
+		spt_remove_page (spt, page);
 	}
+	vma_remove (&spt->vmas, vma);
+	tlb_gather_end (&tlb);
 }
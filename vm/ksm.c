@@ -0,0 +1,235 @@
+/* ksm.c: Merging of identical anonymous pages. */
+
+#include "vm/vm.h"
+#include "vm/ksm.h"
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/thread.h"
+
+/* Ticks between two scans. */
+#define KSM_INTERVAL (TIMER_FREQ / 10)
+
+/* Contents seen once are remembered by hash only; the set is dropped
+ * when it grows past this many entries. */
+#define KSM_UNSTABLE_MAX 1024
+
+int ksm_scan_pages;
+
+/* Shared frames, by contents. */
+static struct hash stable;
+/* Hashes of contents seen once, not merged yet. */
+static struct hash unstable;
+/* Protects both tables and the mappers of every node. */
+static struct lock ksm_lock;
+
+/* Statistics. */
+static size_t node_cnt;             /* Shared frames. */
+static size_t merged_cnt;           /* Pages mapping a shared frame. */
+static long long scan_cnt;          /* Pages looked at. */
+
+struct ksm_seen {
+	uint64_t hash;
+	struct hash_elem elem;
+};
+
+static uint64_t
+ksm_node_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct ksm_node, elem)->hash;
+}
+
+static bool
+ksm_node_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct ksm_node, elem)->hash
+		< hash_entry (b, struct ksm_node, elem)->hash;
+}
+
+static uint64_t
+ksm_seen_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct ksm_seen, elem)->hash;
+}
+
+static bool
+ksm_seen_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct ksm_seen, elem)->hash
+		< hash_entry (b, struct ksm_seen, elem)->hash;
+}
+
+static void
+ksm_seen_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct ksm_seen, elem));
+}
+
+/* Returns the node for contents with HASH, or NULL. There is at most
+ * one: pages whose contents collide with a node's are not merged.
+ * ksm_lock must be held. */
+static struct ksm_node *
+ksm_find (uint64_t hash) {
+	struct ksm_node key;
+	struct hash_elem *e;
+
+	key.hash = hash;
+	e = hash_find (&stable, &key.elem);
+	return e != NULL ? hash_entry (e, struct ksm_node, elem) : NULL;
+}
+
+/* Returns true if contents with HASH were seen before, forgetting them,
+ * or remembers them and returns false. ksm_lock must be held. */
+static bool
+ksm_seen_before (uint64_t hash) {
+	struct ksm_seen key, *seen;
+	struct hash_elem *e;
+
+	key.hash = hash;
+	e = hash_delete (&unstable, &key.elem);
+	if (e != NULL) {
+		free (hash_entry (e, struct ksm_seen, elem));
+		return true;
+	}
+
+	if (hash_size (&unstable) >= KSM_UNSTABLE_MAX)
+		hash_clear (&unstable, ksm_seen_free);
+	seen = malloc (sizeof *seen);
+	if (seen != NULL) {
+		seen->hash = hash;
+		hash_insert (&unstable, &seen->elem);
+	}
+	return false;
+}
+
+/* Lets PAGE, owned by PML4, map NODE's frame. ksm_lock must be held. */
+static void
+ksm_join (struct ksm_node *node, struct page *page, uint64_t *pml4) {
+	pml4_set_page (pml4, page->va, node->frame->kva, false);
+	page->frame = node->frame;
+	page->anon.ksm = node;
+	list_push_back (&node->mappers, &page->anon.ksm_elem);
+	merged_cnt++;
+}
+
+/* Looks at FRAME, which vm_frame_isolate() took off the clock, and
+ * merges its page with identical ones if it has been stable since the
+ * last look. */
+static void
+ksm_scan_frame (struct frame *frame) {
+	struct page *page = frame->page;
+	uint64_t *pml4 = frame->owner->pml4;
+	struct ksm_node *node;
+	uint64_t hash;
+
+	scan_cnt++;
+	/* Pages written since the last look are not worth merging yet. */
+	if (pml4_is_dirty (pml4, page->va)) {
+		pml4_set_dirty (pml4, page->va, false);
+		vm_frame_putback (frame);
+		return;
+	}
+
+	/* From now on a write faults and waits in vm_handle_wp() until the
+	 * frame is no longer busy. */
+	pml4_set_writable (pml4, page->va, false);
+	hash = hash_bytes (frame->kva, PGSIZE);
+
+	lock_acquire (&ksm_lock);
+	node = ksm_find (hash);
+	if (node != NULL && !memcmp (node->frame->kva, frame->kva, PGSIZE)) {
+		/* Same as a shared frame: use that one and free ours. */
+		ksm_join (node, page, pml4);
+		lock_release (&ksm_lock);
+		vm_frame_done (frame);
+		palloc_free_page (frame->kva);
+		vm_free_frame (frame);
+		return;
+	}
+
+	if (node == NULL && ksm_seen_before (hash)
+			&& (node = malloc (sizeof *node)) != NULL) {
+		/* Seen before: this frame becomes the shared one. Its twin will
+		 * join it the next time the scanner comes across it. */
+		node->frame = frame;
+		node->hash = hash;
+		list_init (&node->mappers);
+		hash_insert (&stable, &node->elem);
+		node_cnt++;
+		frame->page = NULL;
+		frame->owner = NULL;
+		frame->ksm = node;
+		ksm_join (node, page, pml4);
+		lock_release (&ksm_lock);
+		vm_frame_done (frame);
+		return;
+	}
+	lock_release (&ksm_lock);
+
+	pml4_set_writable (pml4, page->va, true);
+	vm_frame_putback (frame);
+}
+
+/* Frames worth a look: resident private pages that may be written. */
+static bool
+ksm_candidate (struct frame *frame) {
+	struct page *page = frame->page;
+
+	return frame->shm == NULL && page != NULL
+		&& page->operations->type == VM_ANON && page->writable;
+}
+
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (KSM_INTERVAL);
+		for (int i = 0; i < ksm_scan_pages; i++) {
+			struct frame *frame = vm_frame_isolate (ksm_candidate);
+			if (frame == NULL)
+				break;
+			ksm_scan_frame (frame);
+		}
+	}
+}
+
+/* Starts the scanner if merging is enabled. */
+void
+ksm_init (void) {
+	hash_init (&stable, ksm_node_hash, ksm_node_less, NULL);
+	hash_init (&unstable, ksm_seen_hash, ksm_seen_less, NULL);
+	lock_init (&ksm_lock);
+	if (ksm_scan_pages > 0)
+		thread_create ("ksmd", PRI_DEFAULT, ksmd, NULL);
+}
+
+/* Drops merged PAGE from its node, freeing the shared frame with its
+ * last mapper. The caller has already unmapped or remapped the page. */
+void
+ksm_leave (struct page *page) {
+	struct ksm_node *node = page->anon.ksm;
+
+	lock_acquire (&ksm_lock);
+	list_remove (&page->anon.ksm_elem);
+	page->anon.ksm = NULL;
+	page->frame = NULL;
+	merged_cnt--;
+	if (list_empty (&node->mappers)) {
+		hash_delete (&stable, &node->elem);
+		node_cnt--;
+	} else
+		node = NULL;
+	lock_release (&ksm_lock);
+
+	if (node != NULL) {
+		palloc_free_page (node->frame->kva);
+		vm_free_frame (node->frame);
+		free (node);
+	}
+}
+
+/* Prints merging statistics. */
+void
+ksm_print_stats (void) {
+	printf ("KSM: %lld pages scanned, %zu shared frames for %zu pages, "
+			"%zu pages saved\n", scan_cnt, node_cnt, merged_cnt,
+			merged_cnt - node_cnt);
+}
@@ -0,0 +1,345 @@
+/* shared.c: Memory objects behind MAP_SHARED mappings. */
+
+#include "vm/vm.h"
+#include "vm/shared.h"
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+
+static void shm_page_destroy (struct page *page);
+
+/* Shared pages are never swapped in or out on their own: the frame
+ * belongs to the slot, see vm_claim_shared_page() and shm_slot_evict(). */
+static const struct page_operations shared_ops = {
+	.swap_in = NULL,
+	.swap_out = NULL,
+	.destroy = shm_page_destroy,
+	.type = VM_SHARED,
+};
+
+/* Objects of files, so that every mapping of a file finds the same one. */
+static struct list shm_objects;
+static struct lock shm_lock;
+
+void
+shm_init (void) {
+	list_init (&shm_objects);
+	lock_init (&shm_lock);
+}
+
+static uint64_t
+shm_slot_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct shm_slot *slot = hash_entry (e, struct shm_slot, elem);
+	return hash_int (slot->ofs);
+}
+
+static bool
+shm_slot_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct shm_slot *a = hash_entry (a_, struct shm_slot, elem);
+	const struct shm_slot *b = hash_entry (b_, struct shm_slot, elem);
+	return a->ofs < b->ofs;
+}
+
+static struct shm_object *
+shm_object_alloc (void) {
+	struct shm_object *obj = malloc (sizeof *obj);
+	if (obj == NULL)
+		return NULL;
+	if (!hash_init (&obj->slots, shm_slot_hash, shm_slot_less, NULL)) {
+		free (obj);
+		return NULL;
+	}
+	obj->inode = NULL;
+	obj->file = NULL;
+	obj->ref_cnt = 1;
+	lock_init (&obj->lock);
+	return obj;
+}
+
+/* Returns the object of FILE's inode, creating it on first use. The
+ * caller keeps FILE; the object reopens it for its own I/O. */
+struct shm_object *
+shm_object_open (struct file *file) {
+	struct inode *inode = file_get_inode (file);
+	struct shm_object *obj;
+	struct list_elem *e;
+
+	lock_acquire (&shm_lock);
+	for (e = list_begin (&shm_objects); e != list_end (&shm_objects);
+			e = list_next (e)) {
+		obj = list_entry (e, struct shm_object, elem);
+		if (obj->inode == inode) {
+			obj->ref_cnt++;
+			lock_release (&shm_lock);
+			return obj;
+		}
+	}
+
+	obj = shm_object_alloc ();
+	if (obj != NULL) {
+		obj->file = file_reopen (file);
+		if (obj->file == NULL) {
+			hash_destroy (&obj->slots, NULL);
+			free (obj);
+			obj = NULL;
+		} else {
+			obj->inode = inode;
+			list_push_back (&shm_objects, &obj->elem);
+		}
+	}
+	lock_release (&shm_lock);
+	return obj;
+}
+
+/* Returns a new anonymous object, zero-filled and backed by swap. */
+struct shm_object *
+shm_object_create (void) {
+	return shm_object_alloc ();
+}
+
+/* Returns another reference to OBJ. */
+struct shm_object *
+shm_object_reopen (struct shm_object *obj) {
+	lock_acquire (&shm_lock);
+	obj->ref_cnt++;
+	lock_release (&shm_lock);
+	return obj;
+}
+
+/* Writes the resident page of SLOT back to the object's file if it is
+ * dirty, never past the end of the file. */
+static void
+shm_slot_write (struct shm_slot *slot) {
+	struct shm_object *obj = slot->obj;
+
+	if (obj->file != NULL && slot->dirty) {
+		off_t size = file_length (obj->file) - slot->ofs;
+		if (size > 0)
+			file_write_at (obj->file, slot->frame->kva,
+					size < PGSIZE ? size : PGSIZE, slot->ofs);
+	}
+	slot->dirty = false;
+}
+
+/* Writes back and frees one slot of an object that nobody maps any
+ * more. */
+static void
+shm_slot_free (struct hash_elem *e, void *aux UNUSED) {
+	struct shm_slot *slot = hash_entry (e, struct shm_slot, elem);
+	struct frame *frame;
+
+	ASSERT (list_empty (&slot->mappers));
+	/* An eviction in progress leaves the slot in swap or in the file. */
+	frame = vm_frame_detach (&slot->frame);
+	if (frame != NULL) {
+		shm_slot_write (slot);
+		palloc_free_page (frame->kva);
+		vm_free_frame (frame);
+	} else if (slot->swap_slot_idx != INVALID_SLOT_IDX)
+		swap_free_slot (slot->swap_slot_idx);
+	free (slot);
+}
+
+/* Drops a reference to OBJ, writing back and freeing it with the
+ * last one. */
+void
+shm_object_close (struct shm_object *obj) {
+	if (obj == NULL)
+		return;
+
+	lock_acquire (&shm_lock);
+	if (--obj->ref_cnt > 0) {
+		lock_release (&shm_lock);
+		return;
+	}
+	if (obj->inode != NULL)
+		list_remove (&obj->elem);
+	lock_release (&shm_lock);
+
+	hash_destroy (&obj->slots, shm_slot_free);
+	file_close (obj->file);
+	free (obj);
+}
+
+/* Returns the slot of OBJ at OFS, creating it if needed.
+ * OBJ's lock must be held. */
+static struct shm_slot *
+shm_slot_get (struct shm_object *obj, off_t ofs) {
+	struct shm_slot key;
+	struct hash_elem *e;
+
+	key.ofs = ofs;
+	e = hash_find (&obj->slots, &key.elem);
+	if (e != NULL)
+		return hash_entry (e, struct shm_slot, elem);
+
+	struct shm_slot *slot = malloc (sizeof *slot);
+	if (slot == NULL)
+		return NULL;
+	slot->obj = obj;
+	slot->ofs = ofs;
+	slot->frame = NULL;
+	slot->swap_slot_idx = INVALID_SLOT_IDX;
+	slot->dirty = false;
+	list_init (&slot->mappers);
+	hash_insert (&obj->slots, &slot->elem);
+	return slot;
+}
+
+/* Creates the page for VA inside the shared area VMA on its first
+ * fault. The page is mapped by vm_claim_shared_page(). */
+struct page *
+shm_populate_page (struct vm_area *vma, void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct shm_object *obj = vma->obj;
+	struct shm_slot *slot;
+
+	ASSERT (pg_ofs (va) == 0);
+	ASSERT (vma->start <= va && va < vma->end);
+
+	struct page *page = malloc (sizeof *page);
+	if (page == NULL)
+		return NULL;
+
+	lock_acquire (&obj->lock);
+	slot = shm_slot_get (obj, vma->offset + (va - vma->start));
+	if (slot == NULL) {
+		lock_release (&obj->lock);
+		free (page);
+		return NULL;
+	}
+	*page = (struct page) {
+		.operations = &shared_ops,
+		.va = va,
+		.writable = vma->writable,
+		.vma = vma,
+		.shared = (struct shared_page) {
+			.slot = slot,
+			.owner = thread_current (),
+		},
+	};
+	list_push_back (&slot->mappers, &page->shared.elem);
+	lock_release (&obj->lock);
+
+	spt_insert_page (spt, page);
+	list_push_back (&vma->pages, &page->vma_elem);
+	return page;
+}
+
+/* Fills KVA with the contents of SLOT: from the file, from swap, or
+ * with zeros for a fresh anonymous page. OBJ's lock must be held. */
+bool
+shm_slot_load (struct shm_slot *slot, void *kva) {
+	struct shm_object *obj = slot->obj;
+
+	if (obj->file != NULL) {
+		off_t read = file_read_at (obj->file, kva, PGSIZE, slot->ofs);
+		memset (kva + read, 0, PGSIZE - read);
+	} else if (slot->swap_slot_idx != INVALID_SLOT_IDX) {
+		swap_read_page (slot->swap_slot_idx, kva);
+		slot->swap_slot_idx = INVALID_SLOT_IDX;
+	} else
+		memset (kva, 0, PGSIZE);
+	return true;
+}
+
+/* Takes the frame of SLOT away from all of its mappers and saves its
+ * contents: dirty file pages go back to the file, anonymous pages to
+ * swap. The frame itself is left to the caller. */
+bool
+shm_slot_evict (struct shm_slot *slot) {
+	struct shm_object *obj = slot->obj;
+	struct list_elem *e;
+
+	lock_acquire (&obj->lock);
+	ASSERT (slot->frame != NULL);
+	for (e = list_begin (&slot->mappers); e != list_end (&slot->mappers);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, shared.elem);
+		uint64_t *pml4 = page->shared.owner->pml4;
+		if (page->frame == NULL)
+			continue;
+		if (pml4_is_dirty (pml4, page->va))
+			slot->dirty = true;
+		pml4_clear_page (pml4, page->va);
+		page->frame = NULL;
+	}
+
+	if (obj->file != NULL)
+		shm_slot_write (slot);
+	else
+		slot->swap_slot_idx = swap_write_page (slot->frame->kva);
+	slot->dirty = false;
+	slot->frame = NULL;
+	lock_release (&obj->lock);
+	return true;
+}
+
+/* Writes SLOT back to its file if any mapper dirtied it, leaving it
+ * mapped. Does nothing for anonymous objects. */
+void
+shm_slot_sync (struct shm_slot *slot) {
+	struct shm_object *obj = slot->obj;
+	struct list_elem *e;
+
+	lock_acquire (&obj->lock);
+	if (obj->file != NULL && slot->frame != NULL) {
+		for (e = list_begin (&slot->mappers); e != list_end (&slot->mappers);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, shared.elem);
+			uint64_t *pml4 = page->shared.owner->pml4;
+			if (page->frame != NULL && pml4_is_dirty (pml4, page->va)) {
+				pml4_set_dirty (pml4, page->va, false);
+				slot->dirty = true;
+			}
+		}
+		shm_slot_write (slot);
+	}
+	lock_release (&obj->lock);
+}
+
+/* Returns true if any mapper touched SLOT since the last call, and
+ * clears the accessed bits. Runs under the clock lock, so a busy
+ * object counts as accessed instead of being waited for. */
+bool
+shm_slot_test_accessed (struct shm_slot *slot) {
+	struct shm_object *obj = slot->obj;
+	struct list_elem *e;
+	bool accessed = false;
+
+	if (!lock_try_acquire (&obj->lock))
+		return true;
+	for (e = list_begin (&slot->mappers); e != list_end (&slot->mappers);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, shared.elem);
+		uint64_t *pml4 = page->shared.owner->pml4;
+		if (page->frame != NULL && pml4_is_accessed (pml4, page->va)) {
+			pml4_set_accessed (pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	lock_release (&obj->lock);
+	return accessed;
+}
+
+/* Unmaps PAGE from its owner. The frame stays with the slot, and the
+ * page's dirty bit is folded into the slot. PAGE will be freed by the
+ * caller. */
+static void
+shm_page_destroy (struct page *page) {
+	struct shm_slot *slot = page->shared.slot;
+	uint64_t *pml4 = page->shared.owner->pml4;
+
+	lock_acquire (&slot->obj->lock);
+	if (page->frame != NULL) {
+		if (pml4_is_dirty (pml4, page->va))
+			slot->dirty = true;
+		/* The frame is not ours: keep pml4_destroy() from freeing it. */
+		pml4_clear_page (pml4, page->va);
+		page->frame = NULL;
+	}
+	list_remove (&page->shared.elem);
+	lock_release (&slot->obj->lock);
+}
@@ -2,4 +2,7 @@ vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/vma.c        # mmap regions
+vm_SRC += vm/shared.c     # MAP_SHARED memory objects
+vm_SRC += vm/ksm.c        # Same-page merging
 vm_SRC += vm/inspect.c    # Testing utility
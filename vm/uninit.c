@@ -51,10 +51,16 @@ uninit_initialize (struct page *page, void *kva) {
 	/* Fetch first, page_initialize may overwrite the values */
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
+	enum vm_type type = uninit->type;
 
 	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer (page, uninit->type, kva) &&
-		(init ? init (page, aux) : true);
+	if (!uninit->page_initializer (page, type, kva))
+		return false;
+	/* An anonymous page with contents to load comes from the
+	 * executable. */
+	if (VM_TYPE (type) == VM_ANON)
+		page->anon.file_backed = init != NULL;
+	return init ? init (page, aux) : true;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -0,0 +1,139 @@
+/* vma.c: Per-process virtual memory areas for mmap regions. */
+
+#include "vm/vma.h"
+#include <string.h>
+#include "vm/shared.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+/* Returns the index of the first area whose end is above VA,
+ * i.e. the only area that could contain VA. */
+static size_t
+vma_search (struct vma_table *vt, const void *va) {
+	size_t lo = 0, hi = vt->cnt;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (vt->areas[mid]->end <= va)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void
+vma_table_init (struct vma_table *vt) {
+	vt->areas = NULL;
+	vt->cnt = 0;
+	vt->cap = 0;
+}
+
+/* Releases every area in VT. The pages of the areas must have been
+ * destroyed already, since they write back through the area's file. */
+void
+vma_table_destroy (struct vma_table *vt) {
+	for (size_t i = 0; i < vt->cnt; i++) {
+		file_close (vt->areas[i]->file);
+		shm_object_close (vt->areas[i]->obj);
+		free (vt->areas[i]);
+	}
+	free (vt->areas);
+	vma_table_init (vt);
+}
+
+/* Returns the area containing VA, or NULL. */
+struct vm_area *
+vma_find (struct vma_table *vt, const void *va) {
+	size_t idx = vma_search (vt, va);
+	if (idx < vt->cnt && vt->areas[idx]->start <= va)
+		return vt->areas[idx];
+	return NULL;
+}
+
+/* Returns the first area that ends above VA, or NULL. */
+struct vm_area *
+vma_next (struct vma_table *vt, const void *va) {
+	size_t idx = vma_search (vt, va);
+	return idx < vt->cnt ? vt->areas[idx] : NULL;
+}
+
+/* Returns true if any area intersects [START, END). */
+bool
+vma_overlaps (struct vma_table *vt, const void *start, const void *end) {
+	size_t idx = vma_search (vt, start);
+	return idx < vt->cnt && vt->areas[idx]->start < end;
+}
+
+/* Creates an area mapping LENGTH bytes of FILE from OFFSET at START.
+ * The area takes ownership of FILE, which is NULL for a shared area
+ * (the caller sets OBJ then). Returns NULL on allocation failure. */
+struct vm_area *
+vma_insert (struct vma_table *vt, void *start, size_t length,
+		struct file *file, off_t offset, bool writable) {
+	ASSERT (pg_ofs (start) == 0);
+
+	if (vt->cnt == vt->cap) {
+		size_t cap = vt->cap ? vt->cap * 2 : 4;
+		struct vm_area **areas = realloc (vt->areas, cap * sizeof *areas);
+		if (areas == NULL)
+			return NULL;
+		vt->areas = areas;
+		vt->cap = cap;
+	}
+
+	struct vm_area *vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = pg_round_up (start + length);
+	vma->file = file;
+	vma->obj = NULL;
+	vma->offset = offset;
+	vma->length = length;
+	vma->writable = writable;
+	vma->advice = VM_ADV_NORMAL;
+	list_init (&vma->pages);
+
+	size_t idx = vma_search (vt, start);
+	memmove (vt->areas + idx + 1, vt->areas + idx,
+			(vt->cnt - idx) * sizeof *vt->areas);
+	vt->areas[idx] = vma;
+	vt->cnt++;
+	return vma;
+}
+
+/* Removes VMA from VT and frees it. Its pages must already be gone. */
+void
+vma_remove (struct vma_table *vt, struct vm_area *vma) {
+	ASSERT (list_empty (&vma->pages));
+
+	size_t idx = vma_search (vt, vma->start);
+	ASSERT (idx < vt->cnt && vt->areas[idx] == vma);
+	memmove (vt->areas + idx, vt->areas + idx + 1,
+			(vt->cnt - idx - 1) * sizeof *vt->areas);
+	vt->cnt--;
+
+	file_close (vma->file);
+	shm_object_close (vma->obj);
+	free (vma);
+}
+
+/* Gives DST the MAP_SHARED areas of SRC, referring to the same objects,
+ * for fork. Private areas are not inherited. */
+bool
+vma_table_copy_shared (struct vma_table *dst, struct vma_table *src) {
+	for (size_t i = 0; i < src->cnt; i++) {
+		struct vm_area *vma = src->areas[i];
+		if (vma->obj == NULL)
+			continue;
+
+		struct vm_area *copy = vma_insert (dst, vma->start, vma->length, NULL,
+				vma->offset, vma->writable);
+		if (copy == NULL)
+			return false;
+		copy->obj = shm_object_reopen (vma->obj);
+		copy->advice = vma->advice;
+	}
+	return true;
+}